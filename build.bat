@@ -5,4 +5,6 @@ if not exist build mkdir build
 
 pushd build
 cl ..\tests\tests_main.cpp /I ..\source /Zc:preprocessor /Od /Zi /D_DEBUG /std:c++17 /link /out:common_lib_tests.exe
+cl ..\tests\benchmarks_main.cpp /I ..\source /Zc:preprocessor /O2 /Zi /std:c++17 /link /out:common_lib_benchmarks.exe
+cl ..\tools\log_decoder_main.cpp /I ..\source /Zc:preprocessor /O2 /Zi /std:c++17 /link /out:log_decoder.exe
 popd
@@ -0,0 +1,10 @@
+#!/bin/sh
+set -e
+
+mkdir -p build
+
+cd build
+g++ ../tests/tests_main.cpp -I ../source -O0 -g -D_DEBUG -std=c++17 -rdynamic -lpthread -ldl -o common_lib_tests
+g++ ../tests/benchmarks_main.cpp -I ../source -O2 -g -std=c++17 -rdynamic -lpthread -ldl -o common_lib_benchmarks
+g++ ../tools/log_decoder_main.cpp -I ../source -O2 -g -std=c++17 -rdynamic -lpthread -ldl -o log_decoder
+cd ..
@@ -0,0 +1,4 @@
+@echo off
+setlocal
+
+build\common_lib_benchmarks.exe
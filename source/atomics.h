@@ -0,0 +1,205 @@
+// Copyright 2020-2022 David Colson. All rights reserved.
+
+#pragma once
+
+// Atomics
+// ---------------------
+// Minimal set of atomic operations over plain integers, all with sequentially consistent ordering
+// Add and Exchange return the previous value
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline i64 AtomicLoad(volatile i64* pValue);
+inline void AtomicStore(volatile i64* pValue, i64 value);
+inline i64 AtomicAdd(volatile i64* pValue, i64 amount);
+inline i64 AtomicExchange(volatile i64* pValue, i64 value);
+inline bool AtomicCompareExchange(volatile i64* pValue, i64 expected, i64 desired);
+
+inline i32 AtomicLoad(volatile i32* pValue);
+inline void AtomicStore(volatile i32* pValue, i32 value);
+inline i32 AtomicAdd(volatile i32* pValue, i32 amount);
+inline i32 AtomicExchange(volatile i32* pValue, i32 value);
+inline bool AtomicCompareExchange(volatile i32* pValue, i32 expected, i32 desired);
+
+// Hint to the cpu that we're busy waiting
+inline void CpuRelax();
+
+// Simple spin lock, zero initialized is unlocked
+struct SpinLock {
+	volatile i32 locked { 0 };
+};
+
+inline void SpinLockAcquire(SpinLock& lock);
+inline bool SpinLockTryAcquire(SpinLock& lock);
+inline void SpinLockRelease(SpinLock& lock);
+
+
+// IMPLEMENTATION
+
+#ifdef _MSC_VER
+
+// ***********************************************************************
+
+inline i64 AtomicLoad(volatile i64* pValue) {
+	return _InterlockedCompareExchange64((volatile long long*)pValue, 0, 0);
+}
+
+// ***********************************************************************
+
+inline void AtomicStore(volatile i64* pValue, i64 value) {
+	_InterlockedExchange64((volatile long long*)pValue, value);
+}
+
+// ***********************************************************************
+
+inline i64 AtomicAdd(volatile i64* pValue, i64 amount) {
+	return _InterlockedExchangeAdd64((volatile long long*)pValue, amount);
+}
+
+// ***********************************************************************
+
+inline i64 AtomicExchange(volatile i64* pValue, i64 value) {
+	return _InterlockedExchange64((volatile long long*)pValue, value);
+}
+
+// ***********************************************************************
+
+inline bool AtomicCompareExchange(volatile i64* pValue, i64 expected, i64 desired) {
+	return _InterlockedCompareExchange64((volatile long long*)pValue, desired, expected) == expected;
+}
+
+// ***********************************************************************
+
+inline i32 AtomicLoad(volatile i32* pValue) {
+	return _InterlockedCompareExchange((volatile long*)pValue, 0, 0);
+}
+
+// ***********************************************************************
+
+inline void AtomicStore(volatile i32* pValue, i32 value) {
+	_InterlockedExchange((volatile long*)pValue, value);
+}
+
+// ***********************************************************************
+
+inline i32 AtomicAdd(volatile i32* pValue, i32 amount) {
+	return _InterlockedExchangeAdd((volatile long*)pValue, amount);
+}
+
+// ***********************************************************************
+
+inline i32 AtomicExchange(volatile i32* pValue, i32 value) {
+	return _InterlockedExchange((volatile long*)pValue, value);
+}
+
+// ***********************************************************************
+
+inline bool AtomicCompareExchange(volatile i32* pValue, i32 expected, i32 desired) {
+	return _InterlockedCompareExchange((volatile long*)pValue, desired, expected) == expected;
+}
+
+// ***********************************************************************
+
+inline void CpuRelax() {
+	_mm_pause();
+}
+
+#else
+
+// ***********************************************************************
+
+inline i64 AtomicLoad(volatile i64* pValue) {
+	return __atomic_load_n(pValue, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline void AtomicStore(volatile i64* pValue, i64 value) {
+	__atomic_store_n(pValue, value, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline i64 AtomicAdd(volatile i64* pValue, i64 amount) {
+	return __atomic_fetch_add(pValue, amount, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline i64 AtomicExchange(volatile i64* pValue, i64 value) {
+	return __atomic_exchange_n(pValue, value, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline bool AtomicCompareExchange(volatile i64* pValue, i64 expected, i64 desired) {
+	return __atomic_compare_exchange_n(pValue, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline i32 AtomicLoad(volatile i32* pValue) {
+	return __atomic_load_n(pValue, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline void AtomicStore(volatile i32* pValue, i32 value) {
+	__atomic_store_n(pValue, value, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline i32 AtomicAdd(volatile i32* pValue, i32 amount) {
+	return __atomic_fetch_add(pValue, amount, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline i32 AtomicExchange(volatile i32* pValue, i32 value) {
+	return __atomic_exchange_n(pValue, value, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline bool AtomicCompareExchange(volatile i32* pValue, i32 expected, i32 desired) {
+	return __atomic_compare_exchange_n(pValue, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+// ***********************************************************************
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+#endif
+
+// ***********************************************************************
+
+inline void SpinLockAcquire(SpinLock& lock) {
+	while (true) {
+		if (AtomicExchange(&lock.locked, 1) == 0)
+			return;
+		// wait on a read so we're not hammering the cache line with writes
+		while (AtomicLoad(&lock.locked) != 0)
+			CpuRelax();
+	}
+}
+
+// ***********************************************************************
+
+inline bool SpinLockTryAcquire(SpinLock& lock) {
+	return AtomicLoad(&lock.locked) == 0 && AtomicExchange(&lock.locked, 1) == 0;
+}
+
+// ***********************************************************************
+
+inline void SpinLockRelease(SpinLock& lock) {
+	AtomicStore(&lock.locked, 0);
+}
@@ -13,4 +13,8 @@
 #ifdef _WIN32
 #include "filesystem_win32.cpp"
 #include "debug_win32.cpp"
+#include "memory_win32.cpp"
+#else
+#include "debug_linux.cpp"
+#include "memory_linux.cpp"
 #endif
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "types.h"
+#include "atomics.h"
 #include "memory.h"
 #include "log.h"
 #include "resizable_array.h"
+#include "pool.h"
 #include "light_string.h"
 #include "hashmap.h"
+#include "flat_hashmap.h"
 #include "maths.h"
 #include "base64.h"
 #include "defer.h"
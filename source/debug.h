@@ -7,4 +7,13 @@ struct String;
 namespace Debug {
 u64 CollectStackTrace(void** stackFramesArray, u64 arraySize, u64 framesToSkip = 0);
 String PrintStackTraceToString(void** stackFramesArray, u64 nframes, Arena* pArena);
+String SymbolizeAddress(void* address, Arena* pArena); // name of the function a stack trace frame (return address) is in, or the address in hex
+
+// Symbolizing an address is slow the first time, after that it's cached for everyone. So you can keep raw frames around
+// and only symbolize when something actually gets printed, warm the cache with a batch of frames (from a thread of your
+// own if you like), or skip symbolizing altogether and print raw module+offset frames to resolve offline later
+// against the module map (addr2line, llvm-symbolizer etc)
+void SymbolizeStackFrames(void** stackFramesArray, u64 nframes);
+String PrintStackTraceRaw(void** stackFramesArray, u64 nframes, Arena* pArena);
+String GetModuleMap(Arena* pArena); // "start end base path" per loaded module, raw offsets are relative to base
 }
@@ -0,0 +1,755 @@
+// Copyright 2020-2022 David Colson. All rights reserved.
+
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <unwind.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <cxxabi.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Debug {
+
+// ***********************************************************************
+
+struct UnwindState {
+    void** pFrames;
+    u64 capacity;
+    u64 count;
+    u64 framesToSkip;
+};
+
+static _Unwind_Reason_Code UnwindCallback(_Unwind_Context* pContext, void* pUserData) {
+    UnwindState* pState = (UnwindState*)pUserData;
+    uintptr_t ip = _Unwind_GetIP(pContext);
+    if (ip == 0 || pState->count >= pState->capacity)
+        return _URC_END_OF_STACK;
+
+    if (pState->framesToSkip > 0)
+        pState->framesToSkip--;
+    else
+        pState->pFrames[pState->count++] = (void*)ip;
+    return _URC_NO_REASON;
+}
+
+// ***********************************************************************
+
+// Uses the unwind tables rather than frame pointers, so it works on code built without them
+__attribute__((noinline)) u64 CollectStackTrace(void** stackFramesArray, u64 arraySize, u64 framesToSkip) {
+    // the unwinder starts at this function, skip it like CaptureStackBackTrace does on windows
+    UnwindState state = { stackFramesArray, arraySize, 0, 1 + framesToSkip };
+    _Unwind_Backtrace(UnwindCallback, &state);
+    return state.count;
+}
+
+// Symbolization
+// ---------------------
+// Every module (the executable and each shared library) has its ELF symbol table and DWARF line table read once,
+// the first time one of its addresses is looked up. The module file stays mapped so names can point straight into
+// it. Each address we resolve is cached as well, so printing the same traces over and over stays cheap
+
+struct ModuleSymbol {
+    u64 address;
+    u64 size;
+    const char* pName;
+};
+
+struct LineFile {
+    const char* pDirectory;
+    const char* pName;
+};
+
+struct LineRow {
+    u64 address;
+    u32 file;
+    u32 line;
+};
+
+// A run of rows with increasing addresses, usually one compile unit or function
+struct LineSequence {
+    u64 start;
+    u64 end;
+    i64 firstRow;
+    i64 rowCount;
+};
+
+struct ModuleInfo {
+    u64 loadBias; // runtime address minus the address in the file
+    ResizableArray<ModuleSymbol> symbols;
+    ResizableArray<LineFile> files;
+    ResizableArray<LineRow> rows;
+    ResizableArray<LineSequence> sequences;
+};
+
+struct FrameSymbol {
+    String function;
+    String file;
+    u32 line;
+};
+
+struct SymbolCache {
+    Arena* pArena;
+    HashMap<u64, ModuleInfo*> modules; // by load bias
+    HashMap<void*, FrameSymbol> frames;
+};
+
+static SymbolCache* g_pSymbolCache { nullptr };
+static SpinLock g_symbolCacheLock;
+
+// ***********************************************************************
+
+template<typename T>
+T ReadValue(u8*& p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+u64 ReadULEB(u8*& p) {
+    u64 result = 0;
+    u32 shift = 0;
+    u8 byte;
+    do {
+        byte = *p++;
+        if (shift < 64)
+            result |= u64(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return result;
+}
+
+i64 ReadSLEB(u8*& p) {
+    i64 result = 0;
+    u32 shift = 0;
+    u8 byte;
+    do {
+        byte = *p++;
+        if (shift < 64)
+            result |= i64(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    if (shift < 64 && (byte & 0x40))
+        result |= -(i64(1) << shift);
+    return result;
+}
+
+// ***********************************************************************
+
+enum DwarfConstants {
+    DW_LNS_copy = 1,
+    DW_LNS_advance_pc = 2,
+    DW_LNS_advance_line = 3,
+    DW_LNS_set_file = 4,
+    DW_LNS_const_add_pc = 8,
+    DW_LNS_fixed_advance_pc = 9,
+    DW_LNE_end_sequence = 1,
+    DW_LNE_set_address = 2,
+    DW_LNCT_path = 1,
+    DW_LNCT_directory_index = 2,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_data1 = 0x0b,
+    DW_FORM_strp = 0x0e,
+    DW_FORM_udata = 0x0f,
+    DW_FORM_strx = 0x1a,
+    DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f,
+    DW_FORM_strx1 = 0x25,
+    DW_FORM_strx2 = 0x26,
+    DW_FORM_strx3 = 0x27,
+    DW_FORM_strx4 = 0x28
+};
+
+struct DwarfSections {
+    u8* pLine;
+    u64 lineSize;
+    const char* pLineStr;
+    const char* pStr;
+};
+
+// ***********************************************************************
+
+// Reads one attribute of a DWARF 5 file or directory entry, returns false on a form we don't understand
+bool ReadEntryForm(u8*& p, u64 form, u32 offsetSize, DwarfSections& sections, const char** ppString, u64* pValue) {
+    *ppString = nullptr;
+    *pValue = 0;
+    switch (form) {
+        case DW_FORM_string: *ppString = (const char*)p; p += strlen((const char*)p) + 1; return true;
+        case DW_FORM_line_strp: {
+            u64 offset = offsetSize == 8 ? ReadValue<u64>(p) : ReadValue<u32>(p);
+            *ppString = sections.pLineStr ? sections.pLineStr + offset : nullptr;
+            return true;
+        }
+        case DW_FORM_strp: {
+            u64 offset = offsetSize == 8 ? ReadValue<u64>(p) : ReadValue<u32>(p);
+            *ppString = sections.pStr ? sections.pStr + offset : nullptr;
+            return true;
+        }
+        case DW_FORM_udata: *pValue = ReadULEB(p); return true;
+        case DW_FORM_data1: *pValue = ReadValue<u8>(p); return true;
+        case DW_FORM_data2: *pValue = ReadValue<u16>(p); return true;
+        case DW_FORM_data4: *pValue = ReadValue<u32>(p); return true;
+        case DW_FORM_data8: *pValue = ReadValue<u64>(p); return true;
+        case DW_FORM_data16: p += 16; return true;
+        case DW_FORM_block: p += ReadULEB(p); return true;
+        // string offsets need the compile unit's str_offsets_base, which we don't read, so skip these
+        case DW_FORM_strx: ReadULEB(p); return true;
+        case DW_FORM_strx1: p += 1; return true;
+        case DW_FORM_strx2: p += 2; return true;
+        case DW_FORM_strx3: p += 3; return true;
+        case DW_FORM_strx4: p += 4; return true;
+        default: return false;
+    }
+}
+
+// ***********************************************************************
+
+// Reads a DWARF 5 directory or file name table, the entry layout is described at the start of the table
+bool ReadEntryTable(u8*& p, u32 offsetSize, DwarfSections& sections, ResizableArray<LineFile>& entries, ResizableArray<const char*>& directories) {
+    u64 formats[16][2];
+    u8 formatCount = ReadValue<u8>(p);
+    if (formatCount > 16)
+        return false;
+    for (u8 i = 0; i < formatCount; i++) {
+        formats[i][0] = ReadULEB(p);
+        formats[i][1] = ReadULEB(p);
+    }
+
+    u64 entryCount = ReadULEB(p);
+    for (u64 i = 0; i < entryCount; i++) {
+        LineFile entry = { nullptr, nullptr };
+        for (u8 j = 0; j < formatCount; j++) {
+            const char* pString;
+            u64 value;
+            if (!ReadEntryForm(p, formats[j][1], offsetSize, sections, &pString, &value))
+                return false;
+            if (formats[j][0] == DW_LNCT_path)
+                entry.pName = pString;
+            else if (formats[j][0] == DW_LNCT_directory_index && value < (u64)directories.count)
+                entry.pDirectory = directories[value];
+        }
+        entries.PushBack(entry);
+    }
+    return true;
+}
+
+// ***********************************************************************
+
+void ReadLineTables(ModuleInfo* pModule, DwarfSections& sections) {
+    ScratchScope(scratch, g_pSymbolCache->pArena);
+
+    u8* p = sections.pLine;
+    u8* pEnd = sections.pLine + sections.lineSize;
+    while (p < pEnd) {
+        u32 offsetSize = 4;
+        u64 unitLength = ReadValue<u32>(p);
+        if (unitLength == 0xffffffff) {
+            unitLength = ReadValue<u64>(p);
+            offsetSize = 8;
+        }
+        u8* pUnitEnd = p + unitLength;
+        if (pUnitEnd > pEnd)
+            return;
+
+        u16 version = ReadValue<u16>(p);
+        if (version < 2 || version > 5) {
+            p = pUnitEnd;
+            continue;
+        }
+        u8 addressSize = 8;
+        if (version >= 5) {
+            addressSize = ReadValue<u8>(p);
+            ReadValue<u8>(p); // segment selector size
+        }
+        u64 headerLength = offsetSize == 8 ? ReadValue<u64>(p) : ReadValue<u32>(p);
+        u8* pProgram = p + headerLength;
+
+        u8 minInstructionLength = ReadValue<u8>(p);
+        if (version >= 4)
+            ReadValue<u8>(p); // max ops per instruction, only matters for VLIW
+        ReadValue<u8>(p); // default is_stmt, we keep every row
+        i8 lineBase = ReadValue<i8>(p);
+        u8 lineRange = ReadValue<u8>(p);
+        u8 opcodeBase = ReadValue<u8>(p);
+        u8* pOpcodeLengths = p;
+        p += opcodeBase - 1;
+
+        // This unit's file numbers are indices into its own table, map them to module wide file indices
+        ResizableArray<const char*> directories(scratch.pArena);
+        ResizableArray<LineFile> unitFiles(scratch.pArena);
+        if (version >= 5) {
+            ResizableArray<LineFile> directoryEntries(scratch.pArena);
+            if (!ReadEntryTable(p, offsetSize, sections, directoryEntries, directories)) {
+                p = pUnitEnd;
+                continue;
+            }
+            for (i64 i = 0; i < directoryEntries.count; i++)
+                directories.PushBack(directoryEntries[i].pName);
+            if (!ReadEntryTable(p, offsetSize, sections, unitFiles, directories)) {
+                p = pUnitEnd;
+                continue;
+            }
+        } else {
+            // Before DWARF 5 directory 0 is the compile directory and files count from 1, neither is in the table
+            directories.PushBack(nullptr);
+            while (*p) {
+                directories.PushBack((const char*)p);
+                p += strlen((const char*)p) + 1;
+            }
+            p++;
+            unitFiles.PushBack({ nullptr, nullptr });
+            while (*p) {
+                LineFile file = { nullptr, (const char*)p };
+                p += strlen((const char*)p) + 1;
+                u64 directory = ReadULEB(p);
+                ReadULEB(p); // modification time
+                ReadULEB(p); // file size
+                if (directory < (u64)directories.count)
+                    file.pDirectory = directories[directory];
+                unitFiles.PushBack(file);
+            }
+            p++;
+        }
+        u32 fileBase = (u32)pModule->files.count;
+        for (i64 i = 0; i < unitFiles.count; i++)
+            pModule->files.PushBack(unitFiles[i]);
+
+        // Run the line number program, each emitted row maps an address to a file and line
+        p = pProgram;
+        u64 address = 0;
+        u64 file = 1;
+        i64 line = 1;
+        i64 sequenceStart = pModule->rows.count;
+        while (p < pUnitEnd) {
+            u8 opcode = *p++;
+            bool emitRow = false;
+            if (opcode >= opcodeBase) {  // special opcodes advance address and line together
+                u8 adjusted = opcode - opcodeBase;
+                address += (adjusted / lineRange) * minInstructionLength;
+                line += lineBase + adjusted % lineRange;
+                emitRow = true;
+            } else if (opcode == 0) {
+                u64 length = ReadULEB(p);
+                u8* pNext = p + length;
+                u8 extended = *p++;
+                if (extended == DW_LNE_end_sequence) {
+                    // Sequences for code the linker threw away are left at address 0, skip them
+                    i64 rowCount = pModule->rows.count - sequenceStart;
+                    if (rowCount > 0 && pModule->rows[sequenceStart].address != 0) {
+                        LineSequence sequence = { pModule->rows[sequenceStart].address, address, sequenceStart, rowCount };
+                        pModule->sequences.PushBack(sequence);
+                    } else {
+                        pModule->rows.Resize(sequenceStart);
+                    }
+                    sequenceStart = pModule->rows.count;
+                    address = 0;
+                    file = 1;
+                    line = 1;
+                } else if (extended == DW_LNE_set_address) {
+                    address = addressSize == 8 ? ReadValue<u64>(p) : ReadValue<u32>(p);
+                }
+                p = pNext;
+            } else {
+                switch (opcode) {
+                    case DW_LNS_copy: emitRow = true; break;
+                    case DW_LNS_advance_pc: address += ReadULEB(p) * minInstructionLength; break;
+                    case DW_LNS_advance_line: line += ReadSLEB(p); break;
+                    case DW_LNS_set_file: file = ReadULEB(p); break;
+                    case DW_LNS_const_add_pc: address += ((255 - opcodeBase) / lineRange) * minInstructionLength; break;
+                    case DW_LNS_fixed_advance_pc: address += ReadValue<u16>(p); break;
+                    default:
+                        // everything else (column, is_stmt, isa...) we don't need, just skip its operands
+                        for (u8 i = 0; i < pOpcodeLengths[opcode - 1]; i++)
+                            ReadULEB(p);
+                        break;
+                }
+            }
+
+            if (emitRow && file < (u64)unitFiles.count) {
+                LineRow row = { address, fileBase + u32(file), u32(line) };
+                pModule->rows.PushBack(row);
+            }
+        }
+        pModule->rows.Resize(sequenceStart); // drop rows from an unterminated sequence
+        p = pUnitEnd;
+    }
+}
+
+// ***********************************************************************
+
+struct ModuleSymbolAscending {
+    bool operator()(const ModuleSymbol& a, const ModuleSymbol& b) {
+        return a.address > b.address;
+    }
+};
+
+struct LineSequenceAscending {
+    bool operator()(const LineSequence& a, const LineSequence& b) {
+        return a.start > b.start;
+    }
+};
+
+void LoadModuleFile(ModuleInfo* pModule, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat fileStat;
+    u8* pFile = nullptr;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > (off_t)sizeof(Elf64_Ehdr))
+        pFile = (u8*)mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pFile == nullptr || pFile == (u8*)MAP_FAILED)
+        return;
+
+    Elf64_Ehdr* pHeader = (Elf64_Ehdr*)pFile;
+    if (memcmp(pHeader->e_ident, ELFMAG, SELFMAG) != 0 || pHeader->e_ident[EI_CLASS] != ELFCLASS64 || pHeader->e_shoff == 0) {
+        munmap(pFile, fileStat.st_size);
+        return;
+    }
+
+    Elf64_Shdr* pSections = (Elf64_Shdr*)(pFile + pHeader->e_shoff);
+    const char* pSectionNames = (const char*)(pFile + pSections[pHeader->e_shstrndx].sh_offset);
+    Elf64_Shdr* pSymbolTable = nullptr;
+    Elf64_Shdr* pDynamicSymbols = nullptr;
+    DwarfSections dwarf = {};
+    for (u16 i = 0; i < pHeader->e_shnum; i++) {
+        Elf64_Shdr& section = pSections[i];
+        if (section.sh_type == SHT_SYMTAB)
+            pSymbolTable = &section;
+        else if (section.sh_type == SHT_DYNSYM)
+            pDynamicSymbols = &section;
+        if (section.sh_flags & SHF_COMPRESSED) // would need zlib
+            continue;
+
+        const char* pName = pSectionNames + section.sh_name;
+        if (strcmp(pName, ".debug_line") == 0) {
+            dwarf.pLine = pFile + section.sh_offset;
+            dwarf.lineSize = section.sh_size;
+        } else if (strcmp(pName, ".debug_line_str") == 0) {
+            dwarf.pLineStr = (const char*)(pFile + section.sh_offset);
+        } else if (strcmp(pName, ".debug_str") == 0) {
+            dwarf.pStr = (const char*)(pFile + section.sh_offset);
+        }
+    }
+
+    // The full symbol table has static functions too, stripped binaries only keep the dynamic one
+    if (pSymbolTable == nullptr)
+        pSymbolTable = pDynamicSymbols;
+    if (pSymbolTable) {
+        Elf64_Sym* pSymbols = (Elf64_Sym*)(pFile + pSymbolTable->sh_offset);
+        const char* pNames = (const char*)(pFile + pSections[pSymbolTable->sh_link].sh_offset);
+        u64 symbolCount = pSymbolTable->sh_size / sizeof(Elf64_Sym);
+        for (u64 i = 0; i < symbolCount; i++) {
+            if (ELF64_ST_TYPE(pSymbols[i].st_info) == STT_FUNC && pSymbols[i].st_value != 0) {
+                ModuleSymbol symbol = { pSymbols[i].st_value, pSymbols[i].st_size, pNames + pSymbols[i].st_name };
+                pModule->symbols.PushBack(symbol);
+            }
+        }
+        if (pModule->symbols.count > 0)
+            Sort(pModule->symbols.pData, pModule->symbols.count, ModuleSymbolAscending());
+    }
+
+    if (dwarf.pLine) {
+        ReadLineTables(pModule, dwarf);
+        if (pModule->sequences.count > 0 && !IsSorted(pModule->sequences.pData, pModule->sequences.count, LineSequenceAscending()))
+            Sort(pModule->sequences.pData, pModule->sequences.count, LineSequenceAscending());
+    }
+}
+
+// ***********************************************************************
+
+const char* ModulePath(dl_phdr_info* pInfo) {
+    if (pInfo->dlpi_name[0])
+        return pInfo->dlpi_name;
+
+    // the executable itself has no name here
+    static char executablePath[PATH_MAX] = {};
+    static bool pathRead = [] {
+        ssize_t length = readlink("/proc/self/exe", executablePath, PATH_MAX - 1);
+        if (length <= 0)
+            strcpy(executablePath, "/proc/self/exe");
+        return true;
+    }();
+    (void)pathRead;
+    return executablePath;
+}
+
+// ***********************************************************************
+
+struct ModuleSearch {
+    u64 address;
+    u64 loadBias;
+    const char* path;
+};
+
+static int FindModuleCallback(dl_phdr_info* pInfo, size_t, void* pUserData) {
+    ModuleSearch* pSearch = (ModuleSearch*)pUserData;
+    for (u16 i = 0; i < pInfo->dlpi_phnum; i++) {
+        const ElfW(Phdr)& segment = pInfo->dlpi_phdr[i];
+        u64 start = pInfo->dlpi_addr + segment.p_vaddr;
+        if (segment.p_type == PT_LOAD && pSearch->address >= start && pSearch->address < start + segment.p_memsz) {
+            pSearch->loadBias = pInfo->dlpi_addr;
+            pSearch->path = ModulePath(pInfo);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+ModuleInfo* FindModule(u64 address) {
+    ModuleSearch search = { address, 0, nullptr };
+    if (dl_iterate_phdr(FindModuleCallback, &search) == 0)
+        return nullptr;
+
+    if (ModuleInfo** ppModule = g_pSymbolCache->modules.Get(search.loadBias))
+        return *ppModule;
+
+    ModuleInfo* pModule = New(g_pSymbolCache->pArena, ModuleInfo);
+    pModule->loadBias = search.loadBias;
+    pModule->symbols.pArena = g_pSymbolCache->pArena;
+    pModule->files.pArena = g_pSymbolCache->pArena;
+    pModule->rows.pArena = g_pSymbolCache->pArena;
+    pModule->sequences.pArena = g_pSymbolCache->pArena;
+    LoadModuleFile(pModule, search.path);
+    g_pSymbolCache->modules.Add(search.loadBias, pModule);
+    return pModule;
+}
+
+// ***********************************************************************
+
+const char* FindFunctionName(ModuleInfo* pModule, u64 address) {
+    // last symbol starting at or before the address
+    i64 low = 0;
+    i64 high = pModule->symbols.count;
+    while (low < high) {
+        i64 middle = (low + high) / 2;
+        if (pModule->symbols[middle].address <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0)
+        return nullptr;
+    ModuleSymbol& symbol = pModule->symbols[low - 1];
+    if (symbol.size != 0 && address >= symbol.address + symbol.size)
+        return nullptr;
+    return symbol.pName;
+}
+
+// ***********************************************************************
+
+LineRow* FindLine(ModuleInfo* pModule, u64 address) {
+    i64 low = 0;
+    i64 high = pModule->sequences.count;
+    while (low < high) {
+        i64 middle = (low + high) / 2;
+        if (pModule->sequences[middle].start <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0)
+        return nullptr;
+    LineSequence& sequence = pModule->sequences[low - 1];
+    if (address >= sequence.end)
+        return nullptr;
+
+    // rows in a sequence only ever go up in address
+    low = sequence.firstRow;
+    high = sequence.firstRow + sequence.rowCount;
+    while (low < high) {
+        i64 middle = (low + high) / 2;
+        if (pModule->rows[middle].address <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low > sequence.firstRow ? &pModule->rows[low - 1] : nullptr;
+}
+
+// ***********************************************************************
+
+String DemangledName(const char* pName, Arena* pArena) {
+    int status = 0;
+    char* pDemangled = abi::__cxa_demangle(pName, nullptr, nullptr, &status);
+    if (pDemangled == nullptr)
+        return CopyCString(pName, pArena);
+    String name = CopyCString(pDemangled, pArena);
+    free(pDemangled);
+    return name;
+}
+
+// ***********************************************************************
+
+// Must hold g_symbolCacheLock
+FrameSymbol& ResolveAddress(void* address) {
+    if (g_pSymbolCache == nullptr) {
+        Arena* pArena = ArenaCreate(DEFAULT_RESERVE, true);
+        ArenaSetName(pArena, "Symbol Cache");
+        g_pSymbolCache = New(pArena, SymbolCache);
+        g_pSymbolCache->pArena = pArena;
+        g_pSymbolCache->modules.pArena = pArena;
+        g_pSymbolCache->frames.pArena = pArena;
+    }
+
+    if (FrameSymbol* pCached = g_pSymbolCache->frames.Get(address))
+        return *pCached;
+
+    Arena* pArena = g_pSymbolCache->pArena;
+    FrameSymbol symbol;
+    symbol.line = 0;
+    if (ModuleInfo* pModule = FindModule(u64(address))) {
+        u64 fileAddress = u64(address) - pModule->loadBias;
+        if (const char* pName = FindFunctionName(pModule, fileAddress))
+            symbol.function = DemangledName(pName, pArena);
+
+        if (LineRow* pRow = FindLine(pModule, fileAddress)) {
+            LineFile& file = pModule->files[pRow->file];
+            if (file.pName && file.pName[0] != '/' && file.pDirectory) {
+                StringBuilder builder(pArena);
+                builder.Append(file.pDirectory);
+                builder.Append("/");
+                builder.Append(file.pName);
+                symbol.file = builder.CreateString(pArena);
+            } else if (file.pName) {
+                symbol.file = CopyCString(file.pName, pArena);
+            }
+            symbol.line = pRow->line;
+        }
+    }
+
+    // Modules we couldn't read from disk (the vdso for one) can still have exported names
+    Dl_info info;
+    if (symbol.function.length == 0 && dladdr(address, &info) && info.dli_sname)
+        symbol.function = DemangledName(info.dli_sname, pArena);
+
+    if (symbol.function.length == 0) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "0x%llx", (unsigned long long)address);
+        symbol.function = CopyCString(buffer, pArena);
+    }
+    if (symbol.file.length == 0)
+        symbol.file = String("??");
+
+    g_pSymbolCache->frames.Add(address, symbol);
+    return *g_pSymbolCache->frames.Get(address);
+}
+
+// ***********************************************************************
+
+void SymbolizeStackFrames(void** stackFramesArray, u64 nframes) {
+    SpinLockAcquire(g_symbolCacheLock);
+    for (u64 j = 0; j < nframes; j++)
+        ResolveAddress((u8*)stackFramesArray[j] - 1);
+    SpinLockRelease(g_symbolCacheLock);
+}
+
+// ***********************************************************************
+
+String PrintStackTraceToString(void** stackFramesArray, u64 nframes, Arena* pArena) {
+	Assert(pArena);
+
+    SpinLockAcquire(g_symbolCacheLock);
+    ResizableArray<FrameSymbol> frames(pArena);
+    u64 longestName = 0;
+    for (u64 j = 0; j < nframes; j++) {
+        // These are return addresses, step back into the call instruction so we get its line
+        FrameSymbol symbol = ResolveAddress((u8*)stackFramesArray[j] - 1);
+        if ((u64)symbol.function.length > longestName)
+            longestName = symbol.function.length;
+        frames.PushBack(symbol);
+    }
+    SpinLockRelease(g_symbolCacheLock);
+
+    StringBuilder builder(pArena);
+    for (u64 j = 0; j < nframes; j++) {
+        char lineNumber[16];
+        snprintf(lineNumber, sizeof(lineNumber), ":%u\n", frames[j].line);
+        builder.Append(" ");
+        builder.Append(frames[j].function);
+        for (u64 k = frames[j].function.length; k < longestName; k++)
+            builder.Append(" ");
+        builder.Append(" ");
+        builder.Append(frames[j].file);
+        builder.Append(lineNumber);
+    }
+    String output = builder.CreateString(pArena, true);
+    return output;
+}
+
+// ***********************************************************************
+
+String PrintStackTraceRaw(void** stackFramesArray, u64 nframes, Arena* pArena) {
+    // No symbol lookups, just which module each frame is in, the offset is what addr2line wants for that file
+    StringBuilder builder(pArena);
+    for (u64 j = 0; j < nframes; j++) {
+        ModuleSearch search = { u64(stackFramesArray[j]), 0, "??" };
+        dl_iterate_phdr(FindModuleCallback, &search);
+
+        char line[64];
+        snprintf(line, sizeof(line), " 0x%llx ", (unsigned long long)stackFramesArray[j]);
+        builder.Append(line);
+        builder.Append(search.path);
+        snprintf(line, sizeof(line), "+0x%llx\n", (unsigned long long)(search.address - search.loadBias));
+        builder.Append(line);
+    }
+    return builder.CreateString(pArena, true);
+}
+
+// ***********************************************************************
+
+static int ModuleMapCallback(dl_phdr_info* pInfo, size_t, void* pUserData) {
+    StringBuilder* pBuilder = (StringBuilder*)pUserData;
+    u64 start = ~0ull;
+    u64 end = 0;
+    for (u16 i = 0; i < pInfo->dlpi_phnum; i++) {
+        const ElfW(Phdr)& segment = pInfo->dlpi_phdr[i];
+        if (segment.p_type != PT_LOAD)
+            continue;
+        if (pInfo->dlpi_addr + segment.p_vaddr < start)
+            start = pInfo->dlpi_addr + segment.p_vaddr;
+        if (pInfo->dlpi_addr + segment.p_vaddr + segment.p_memsz > end)
+            end = pInfo->dlpi_addr + segment.p_vaddr + segment.p_memsz;
+    }
+    if (end == 0)
+        return 0;
+
+    char line[96];
+    snprintf(line, sizeof(line), "0x%llx 0x%llx 0x%llx ", (unsigned long long)start, (unsigned long long)end, (unsigned long long)pInfo->dlpi_addr);
+    pBuilder->Append(line);
+    pBuilder->Append(ModulePath(pInfo));
+    pBuilder->Append("\n");
+    return 0;
+}
+
+String GetModuleMap(Arena* pArena) {
+    // base is the load bias, so raw offsets are addresses in the file like addr2line expects
+    StringBuilder builder(pArena);
+    dl_iterate_phdr(ModuleMapCallback, &builder);
+    return builder.CreateString(pArena, true);
+}
+
+// ***********************************************************************
+
+String SymbolizeAddress(void* address, Arena* pArena) {
+    // a return address like the other calls take, so the same frame resolves (and caches) the same way
+    SpinLockAcquire(g_symbolCacheLock);
+    String name = CopyString(ResolveAddress((u8*)address - 1).function, pArena);
+    SpinLockRelease(g_symbolCacheLock);
+    return name;
+}
+
+}
+#endif
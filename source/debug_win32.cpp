@@ -12,49 +12,139 @@ u64 CollectStackTrace(void** stackFramesArray, u64 arraySize, u64 framesToSkip)
 
 // ***********************************************************************
 
-String PrintStackTraceToString(void** stackFramesArray, u64 nframes, Arena* pArena) {
-	Assert(pArena);
+// Every address we symbolize is cached, dbghelp lookups are slow and the same traces tend to get printed over and over
+
+struct FrameSymbol {
+    String function;
+    String file;
+    u32 line;
+};
+
+static Arena* g_pSymbolArena { nullptr };
+static HashMap<void*, FrameSymbol> g_symbolCache(nullptr);
+static SpinLock g_symbolCacheLock;
+
+// ***********************************************************************
 
+// Must hold g_symbolCacheLock
+FrameSymbol& ResolveAddress(void* address) {
     HANDLE process = GetCurrentProcess();
-    SymInitialize(process, nullptr, true);
+    if (g_pSymbolArena == nullptr) {
+        // dbghelp loads symbols for every module on init, so only ever do it once
+        SymInitialize(process, nullptr, true);
+        g_pSymbolArena = ArenaCreate(DEFAULT_RESERVE, true);
+        ArenaSetName(g_pSymbolArena, "Symbol Cache");
+        g_symbolCache.pArena = g_pSymbolArena;
+    }
+
+    if (FrameSymbol* pCached = g_symbolCache.Get(address))
+        return *pCached;
 
     // We allocate space for the symbol info and space for the name string
-    SYMBOL_INFO* symbol;
-    symbol = (SYMBOL_INFO*)ArenaAlloc(pArena, sizeof(SYMBOL_INFO) + 256 * sizeof(byte), alignof(byte), false);
-    memset(symbol, 0, sizeof(SYMBOL_INFO) + 256 * sizeof(byte));
+    byte buffer[sizeof(SYMBOL_INFO) + 256 * sizeof(byte)];
+    SYMBOL_INFO* symbol = (SYMBOL_INFO*)buffer;
+    memset(symbol, 0, sizeof(buffer));
     symbol->MaxNameLen = 255;
     symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+
+    FrameSymbol frame;
+    if (SymFromAddr(process, (u64)address, 0, symbol))
+        frame.function = CopyCString(symbol->Name, g_pSymbolArena);
+    else
+        frame.function = StringPrint(g_pSymbolArena, "0x%llx", (u64)address);
+
+    IMAGEHLP_LINE64 line;
+    memset(&line, 0, sizeof(line));
+    line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
     DWORD displacement;
+    if (SymGetLineFromAddr64(process, (u64)address, &displacement, &line)) {
+        frame.file = CopyCString(line.FileName, g_pSymbolArena);
+        frame.line = line.LineNumber;
+    } else {
+        frame.file = String("??");
+        frame.line = 0;
+    }
 
-    ResizableArray<String> stackFuncs(pArena);
-    ResizableArray<String> stackFiles(pArena);
-    ResizableArray<u32> stackLines(pArena);
+    g_symbolCache.Add(address, frame);
+    return *g_symbolCache.Get(address);
+}
 
-    u64 longestName = 0;
-    for (u32 j = 0; j < nframes - 6; j++) {
-        if (!SymFromAddr(process, (u64)(stackFramesArray[j]), 0, symbol)) {
-            u32 d = GetLastError();
-        }
+// ***********************************************************************
 
-        IMAGEHLP_LINE line;
-        SymGetLineFromAddr(process, (u64)(stackFramesArray[j]), &displacement, &line);
+String PrintStackTraceToString(void** stackFramesArray, u64 nframes, Arena* pArena) {
+	Assert(pArena);
 
-        u64 len = strlen(symbol->Name);
-        if (len > longestName)
-            longestName = len;
+    // the last few frames are always the CRT starting up
+    u64 printedFrames = nframes > 6 ? nframes - 6 : nframes;
 
-        stackFuncs.PushBack(CopyCString(symbol->Name, pArena));
-        stackFiles.PushBack(CopyCString(line.FileName, pArena));
-        stackLines.PushBack(line.LineNumber);
+    SpinLockAcquire(g_symbolCacheLock);
+    ResizableArray<FrameSymbol> frames(pArena);
+    u64 longestName = 0;
+    for (u64 j = 0; j < printedFrames; j++) {
+        // These are return addresses, step back into the call instruction so we get its line
+        FrameSymbol frame = ResolveAddress((u8*)stackFramesArray[j] - 1);
+        if ((u64)frame.function.length > longestName)
+            longestName = frame.function.length;
+        frames.PushBack(frame);
     }
+    SpinLockRelease(g_symbolCacheLock);
 
     StringBuilder builder(pArena);
-    for (u32 j = 0; j < nframes - 6; j++) {
-        builder.AppendFormat(" %-*s %s:%u\n", (int)longestName, stackFuncs[j].pData, stackFiles[j].pData, stackLines[j]);
+    for (u64 j = 0; j < printedFrames; j++) {
+        builder.AppendFormat(" %-*s %s:%u\n", (int)longestName, frames[j].function.pData, frames[j].file.pData, frames[j].line);
     }
     String output = builder.CreateString(pArena, true);
     return output;
 }
 
+// ***********************************************************************
+
+String SymbolizeAddress(void* address, Arena* pArena) {
+    // a return address like the other calls take, so the same frame resolves (and caches) the same way
+    SpinLockAcquire(g_symbolCacheLock);
+    String name = CopyString(ResolveAddress((u8*)address - 1).function, pArena);
+    SpinLockRelease(g_symbolCacheLock);
+    return name;
+}
+
+// ***********************************************************************
+
+void SymbolizeStackFrames(void** stackFramesArray, u64 nframes) {
+    SpinLockAcquire(g_symbolCacheLock);
+    for (u64 j = 0; j < nframes; j++)
+        ResolveAddress((u8*)stackFramesArray[j] - 1);
+    SpinLockRelease(g_symbolCacheLock);
+}
+
+// ***********************************************************************
+
+String PrintStackTraceRaw(void** stackFramesArray, u64 nframes, Arena* pArena) {
+    StringBuilder builder(pArena);
+    for (u64 j = 0; j < nframes; j++) {
+        // No dbghelp here, finding the module an address is in is just a walk of the loader's list
+        HMODULE module = nullptr;
+        char path[MAX_PATH] = "??";
+        GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR)stackFramesArray[j], &module);
+        if (module)
+            GetModuleFileNameA(module, path, MAX_PATH);
+        builder.AppendFormat(" 0x%llx %s+0x%llx\n", (u64)stackFramesArray[j], path, (u64)stackFramesArray[j] - (u64)module);
+    }
+    return builder.CreateString(pArena, true);
+}
+
+// ***********************************************************************
+
+static BOOL CALLBACK ModuleMapCallback(PCSTR moduleName, DWORD64 moduleBase, ULONG moduleSize, PVOID pUserContext) {
+    // offsets in raw traces are relative to the load address on windows
+    StringBuilder* pBuilder = (StringBuilder*)pUserContext;
+    pBuilder->AppendFormat("0x%llx 0x%llx 0x%llx %s\n", moduleBase, moduleBase + moduleSize, moduleBase, moduleName);
+    return true;
+}
+
+String GetModuleMap(Arena* pArena) {
+    StringBuilder builder(pArena);
+    EnumerateLoadedModules64(GetCurrentProcess(), ModuleMapCallback, &builder);
+    return builder.CreateString(pArena, true);
+}
 }
 #endif
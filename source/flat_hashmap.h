@@ -0,0 +1,359 @@
+// Copyright 2020-2022 David Colson. All rights reserved.
+
+#pragma once
+
+// Flat Hashmap
+// -----------------------
+// Swiss table style open addressing, for maps that see a lot of lookups (and especially misses)
+// Keys and values live in their own arrays, and alongside them there's one control byte per slot holding either
+// 7 bits of that slot's hash, or empty/deleted. Probing looks at a group of 16 control bytes at a time, all
+// compared in one go with SSE2 or NEON, so a lookup usually reads one group of control bytes and compares at most
+// a key or two. Misses stop at the first group with an empty slot without touching any keys.
+// Uses the same KeyFuncs as HashMap. The hash is mixed again internally, so weak custom hashes are still fine
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_HASHMAP_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define FLAT_HASHMAP_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define FLAT_GROUP_SIZE 16
+#define FLAT_CONTROL_EMPTY ((i8)-128)
+#define FLAT_CONTROL_DELETED ((i8)-2)
+// full slots hold 0..127
+
+// Which slots of a group matched, FlatMaskLowestSlot gives the first and mask &= mask - 1 moves to the next
+// The NEON version has 4 bits per slot (only the top one is kept), the others one bit per slot
+#ifdef FLAT_HASHMAP_NEON
+#define FLAT_MASK_SLOT_SHIFT 2
+#else
+#define FLAT_MASK_SLOT_SHIFT 0
+#endif
+
+inline i64 FlatMaskLowestSlot(u64 mask);
+
+struct FlatGroup {
+    const i8* pControl;
+
+    u64 Match(i8 h2) const;
+    u64 MatchEmpty() const;
+    u64 MatchEmptyOrDeleted() const;
+};
+
+template<typename K, typename V, typename KF = KeyFuncs<K>>
+struct FlatHashMap {
+    i8* pControl{nullptr}; // tableSize bytes, aligned to a group
+    K* pKeys{nullptr};
+    V* pValues{nullptr};
+    KF keyFuncs;
+    i64 tableSize{0}; // power of two, and at least one group
+    i64 count{0};
+    i64 deletedCount{0};
+    Arena* pArena{nullptr};
+
+    // Free the old table after growing, rather than leaving it until the arena is reset. Only for maps nothing
+    // holds a copy of, copies are shallow
+    bool releaseOldTables{false};
+
+    FlatHashMap(Arena* pArena);
+
+    V& Add(const K& key, const V& value);
+
+    V* Get(const K& key);
+
+    V& GetOrAdd(const K& key);
+
+    V& operator[](const K& key);
+
+    void Erase(const K& key);
+
+    void Rehash(i64 requiredTableSize);
+
+    // bytes for the control, key and value arrays of a table this big
+    i64 AllocationSize(i64 size) const;
+
+    u64 HashKey(const K& key) const;
+
+    i64 FindIndex(const K& key, u64 hash) const;
+
+    V& Insert(u64 hash, const K& key, const V& value);
+};
+
+
+// implementation
+
+// ***********************************************************************
+
+inline i64 FlatMaskLowestSlot(u64 mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return i64(index) >> FLAT_MASK_SLOT_SHIFT;
+#else
+    return i64(__builtin_ctzll(mask)) >> FLAT_MASK_SLOT_SHIFT;
+#endif
+}
+
+#if defined(FLAT_HASHMAP_SSE2)
+
+// ***********************************************************************
+
+inline u64 FlatGroup::Match(i8 h2) const {
+    __m128i control = _mm_load_si128((const __m128i*)pControl);
+    return (u64)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(h2)));
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::MatchEmpty() const {
+    return Match(FLAT_CONTROL_EMPTY);
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::MatchEmptyOrDeleted() const {
+    // empty and deleted are the only negative values below -1, and movemask takes the sign bits anyway
+    __m128i control = _mm_load_si128((const __m128i*)pControl);
+    return (u64)_mm_movemask_epi8(_mm_cmplt_epi8(control, _mm_set1_epi8(-1)));
+}
+
+#elif defined(FLAT_HASHMAP_NEON)
+
+// ***********************************************************************
+
+// NEON has no movemask, narrowing each 16 bit lane by 4 packs the 16 byte results into 16 nibbles instead
+inline u64 FlatNeonMask(uint8x16_t matches) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ull;
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::Match(i8 h2) const {
+    int8x16_t control = vld1q_s8(pControl);
+    return FlatNeonMask(vceqq_s8(control, vdupq_n_s8(h2)));
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::MatchEmpty() const {
+    return Match(FLAT_CONTROL_EMPTY);
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::MatchEmptyOrDeleted() const {
+    int8x16_t control = vld1q_s8(pControl);
+    return FlatNeonMask(vcltq_s8(control, vdupq_n_s8(-1)));
+}
+
+#else
+
+// ***********************************************************************
+
+inline u64 FlatGroup::Match(i8 h2) const {
+    u64 mask = 0;
+    for (int i = 0; i < FLAT_GROUP_SIZE; i++) {
+        if (pControl[i] == h2)
+            mask |= 1ull << i;
+    }
+    return mask;
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::MatchEmpty() const {
+    return Match(FLAT_CONTROL_EMPTY);
+}
+
+// ***********************************************************************
+
+inline u64 FlatGroup::MatchEmptyOrDeleted() const {
+    u64 mask = 0;
+    for (int i = 0; i < FLAT_GROUP_SIZE; i++) {
+        if (pControl[i] < -1)
+            mask |= 1ull << i;
+    }
+    return mask;
+}
+
+#endif
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+inline FlatHashMap<K, V, KF>::FlatHashMap(Arena* _pArena) {
+	pArena = _pArena;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+inline u64 FlatHashMap<K, V, KF>::HashKey(const K& key) const {
+    // The low 7 bits become the control byte and the rest picks the group, so every bit has to count
+    u64 hash = keyFuncs.Hash(key) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+i64 FlatHashMap<K, V, KF>::FindIndex(const K& key, u64 hash) const {
+    if (tableSize == 0)
+        return -1;
+
+    i8 h2 = i8(hash & 0x7f);
+    i64 groupMask = tableSize / FLAT_GROUP_SIZE - 1;
+    i64 group = (hash >> 7) & groupMask;
+    for (i64 probe = 1; probe <= groupMask + 1; probe++) {
+        FlatGroup flatGroup { pControl + group * FLAT_GROUP_SIZE };
+        for (u64 matches = flatGroup.Match(h2); matches; matches &= matches - 1) {
+            i64 index = group * FLAT_GROUP_SIZE + FlatMaskLowestSlot(matches);
+            if (keyFuncs.Cmp(pKeys[index], key))
+                return index;
+        }
+        // an empty slot means the key would have gone here, so it isn't any further on
+        if (flatGroup.MatchEmpty())
+            return -1;
+        group = (group + probe) & groupMask; // triangular steps visit every group
+    }
+    return -1;
+}
+
+// ***********************************************************************
+
+// Assumes there's room
+template<typename K, typename V, typename KF>
+V& FlatHashMap<K, V, KF>::Insert(u64 hash, const K& key, const V& value) {
+    i64 groupMask = tableSize / FLAT_GROUP_SIZE - 1;
+    i64 group = (hash >> 7) & groupMask;
+    for (i64 probe = 1; ; probe++) {
+        FlatGroup flatGroup { pControl + group * FLAT_GROUP_SIZE };
+        u64 available = flatGroup.MatchEmptyOrDeleted();
+        if (available) {
+            i64 index = group * FLAT_GROUP_SIZE + FlatMaskLowestSlot(available);
+            if (pControl[index] == FLAT_CONTROL_DELETED)
+                deletedCount--;
+            pControl[index] = i8(hash & 0x7f);
+            pKeys[index] = key;
+            pValues[index] = value;
+            count++;
+            return pValues[index];
+        }
+        group = (group + probe) & groupMask;
+    }
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+V& FlatHashMap<K, V, KF>::Add(const K& key, const V& value) {
+    // deleted slots still make probes longer, so they count towards the 7/8 max load
+    if ((count + deletedCount + 1) * 8 > tableSize * 7)
+        Rehash(count * 2 < tableSize ? tableSize : tableSize + 1); // mostly deleted, just clean them out
+
+    return Insert(HashKey(key), key, value);
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+V* FlatHashMap<K, V, KF>::Get(const K& key) {
+    i64 index = FindIndex(key, HashKey(key));
+    return index >= 0 ? &pValues[index] : nullptr;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+V& FlatHashMap<K, V, KF>::GetOrAdd(const K& key) {
+    u64 hash = HashKey(key);
+    i64 index = FindIndex(key, hash);
+    if (index >= 0)
+        return pValues[index];
+
+    if ((count + deletedCount + 1) * 8 > tableSize * 7)
+        Rehash(count * 2 < tableSize ? tableSize : tableSize + 1);
+    return Insert(hash, key, V());
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+V& FlatHashMap<K, V, KF>::operator[](const K& key) {
+    return GetOrAdd(key);
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+void FlatHashMap<K, V, KF>::Erase(const K& key) {
+    i64 index = FindIndex(key, HashKey(key));
+    if (index < 0)
+        return;
+
+    // A group that still has an empty slot has never been full, so nothing probed past it and the slot can go
+    // straight back to empty. Otherwise later keys may have, and lookups must carry on past this slot
+    FlatGroup flatGroup { pControl + (index & ~i64(FLAT_GROUP_SIZE - 1)) };
+    if (flatGroup.MatchEmpty()) {
+        pControl[index] = FLAT_CONTROL_EMPTY;
+    } else {
+        pControl[index] = FLAT_CONTROL_DELETED;
+        deletedCount++;
+    }
+    count--;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+void FlatHashMap<K, V, KF>::Rehash(i64 requiredTableSize) {
+    if (requiredTableSize < tableSize)
+        return;
+
+    i8* pControlOld = pControl;
+    K* pKeysOld = pKeys;
+    V* pValuesOld = pValues;
+
+    // double the table size until we can fit required table size
+    constexpr i64 minTableSize = 32;
+    i64 newTableSize = minTableSize;
+    while (newTableSize < (requiredTableSize > minTableSize ? requiredTableSize : minTableSize))
+        newTableSize *= 2;
+
+    // one allocation for all three arrays, control bytes first so they're aligned for the group loads
+    i64 alignment = alignof(K) > alignof(V) ? alignof(K) : alignof(V);
+    u8* pMemory = (u8*)ArenaAllocReleasable(pArena, AllocationSize(newTableSize), alignment > FLAT_GROUP_SIZE ? alignment : FLAT_GROUP_SIZE);
+    i64 keysOffset = Align(newTableSize, alignof(K));
+    i64 valuesOffset = Align(keysOffset + newTableSize * sizeof(K), alignof(V));
+    pControl = (i8*)pMemory;
+    pKeys = (K*)(pMemory + keysOffset);
+    pValues = (V*)(pMemory + valuesOffset);
+    memset(pControl, FLAT_CONTROL_EMPTY, newTableSize);
+
+    i64 oldTableSize = tableSize;
+    tableSize = newTableSize;
+    count = 0;
+    deletedCount = 0;
+    for (i64 i = 0; i < oldTableSize; i++) {
+        if (pControlOld[i] >= 0)
+            Insert(HashKey(pKeysOld[i]), pKeysOld[i], pValuesOld[i]);
+    }
+    if (pControlOld && releaseOldTables)
+        ArenaFree(pArena, pControlOld, AllocationSize(oldTableSize));
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+inline i64 FlatHashMap<K, V, KF>::AllocationSize(i64 size) const {
+    i64 keysOffset = Align(size, alignof(K));
+    i64 valuesOffset = Align(keysOffset + size * sizeof(K), alignof(V));
+    return valuesOffset + size * sizeof(V);
+}
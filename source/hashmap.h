@@ -4,6 +4,21 @@
 
 struct String;
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Hash functions
+// -------------------------------
+// Tables index with the low bits of the hash, so every input bit has to affect them. Integers, pointers
+// (always aligned) and sequential ids all need mixing first
+
+// Well mixed 64 bit integer hash (the splitmix64 finalizer)
+inline u64 HashInt(u64 key);
+
+// Fast hash of a block of memory, wyhash style, reads 8 bytes at a time and mixes with 128 bit multiplies
+inline u64 HashBytes(const void* pData, u64 length, u64 seed = 0);
+
 // Key functions define all the needed operations
 // for each key. So the hashing function and the key comparison
 // -------------------------------
@@ -11,7 +26,7 @@ struct String;
 template<typename K>
 struct KeyFuncs {
     u64 Hash(K key) const {
-        return static_cast<u64>(key);
+        return HashInt(static_cast<u64>(key));
     }
 
     bool Cmp(K key1, K key2) const {
@@ -123,20 +138,57 @@ struct HashNode {
     V value;
 };
 
+// Walks the occupied nodes of a table, skipping the empty slots between them
+template<typename K, typename V>
+struct HashMapIterator {
+    HashNode<K, V>* pNode;
+    HashNode<K, V>* pEnd;
+    // while an incremental rehash is under way the old table is walked after the new one
+    HashNode<K, V>* pNextTable;
+    HashNode<K, V>* pNextEnd;
+
+    HashNode<K, V>& operator*() const { return *pNode; }
+    HashNode<K, V>* operator->() const { return pNode; }
+    bool operator!=(const HashMapIterator& other) const { return pNode != other.pNode; }
+    HashMapIterator& operator++();
+    void SkipUnused();
+};
+
 
 // Hashmap data structure
 // -----------------------
 // Open addressing to reduce memory allocs and improve cache coherency
-// TODO Documentation etc
+// Table sizes are powers of two, probing is linear with robin hood insertion, a new key takes the slot of any
+// key that's closer to its home slot than the new one is. That keeps probe lengths short and even at high
+// load, and lets a lookup stop as soon as it reaches a key closer to home than the one it's looking for.
+// Erase shifts the rest of the probe run back a slot instead of leaving tombstones
+// Big tables get their own reservation (see ArenaAllocReleasable). Tables left behind by growing stay until the
+// arena is reset, unless releaseOldTables is set, then they're given straight back. Set rehashStep to spread the
+// move to a bigger table over later calls
+// Pointers and references from Add, Get, GetOrAdd and [] only last until the next Add, GetOrAdd, [] or Erase, any
+// of which may move nodes. Copies are shallow and share the tables, so only ever read through a copy. A copy taken
+// before the map grew keeps reading the old table, which is why releasing it has to be asked for
 
 template<typename K, typename V, typename KF = KeyFuncs<K>>
 struct HashMap {
     HashNode<K, V>* pTable{nullptr};
     KF keyFuncs;
     i64 tableSize{0};
-    i64 count{0};
+    i64 count{0}; // includes keys still in the old table
 	Arena* pArena{nullptr};
 
+    // 0 moves everything to the new table when growing. Otherwise each Add, GetOrAdd and Erase moves on at least
+    // this many slots of the old table, and lookups check both until it's empty. Needs to be 2 or more to be done
+    // before the next grow, or that one finishes it off in one go
+    i64 rehashStep{0};
+    HashNode<K, V>* pOldTable{nullptr};
+    i64 oldTableSize{0};
+    i64 migrateStart{0}; // the old table is walked from here, an empty slot, so it only ever stops between runs
+    i64 migrated{0};
+
+    // Free each old table once it's empty. Only for maps nothing holds a copy of
+    bool releaseOldTables{false};
+
     HashMap(Arena* pArena);
 
     V& Add(const K& key, const V& value);
@@ -152,17 +204,149 @@ struct HashMap {
     template<typename F>
     void Erase(const K& key, F&& freeNode);
 
+    // Makes room for at least this many keys in total, so adding up to that many won't rehash
+    void Reserve(i64 elementCount);
+
+    // Adds keys and values pairwise, sizing the table once up front. Like Add, keys are assumed not to be
+    // in the map already
+    void AddBulk(const K* pKeys, const V* pValues, i64 elementCount);
+
+    // Empties the map but keeps the table, so refilling it to a similar size doesn't allocate
+    void Clear();
+
+    HashMapIterator<K, V> begin();
+
+    HashMapIterator<K, V> end();
+
     void Rehash(i64 requiredTableSize);
+
+    // moves at least this many slots of the old table over, if there is one
+    void RehashStep(i64 slots);
+
+    void FinishRehash();
+
+    // how far the node in this slot is from the slot its hash wants
+    i64 ProbeLength(i64 index) const;
+
+    u64 HashKey(const K& key) const;
+
+    i64 FindIndex(const K& key, u64 hash) const;
+
+    V& Insert(u64 hash, const K& key, const V& value);
 };
 
+inline i64 HashProbeLength(u64 hash, i64 index, i64 tableSize);
+
+template<typename K, typename V, typename KF>
+i64 HashFindIndex(const HashNode<K, V>* pNodes, i64 tableSize, const KF& keyFuncs, const K& key, u64 hash);
+
+template<typename K, typename V>
+void HashEraseIndex(HashNode<K, V>* pNodes, i64 tableSize, i64 index);
+
 
 // implementation
 
 // ***********************************************************************
 
+inline u64 HashInt(u64 key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+// ***********************************************************************
+
+// Full 128 bit product of a and b, low half back in a and high half in b
+inline void HashMultiply(u64* pA, u64* pB) {
+#ifdef _MSC_VER
+    *pA = _umul128(*pA, *pB, pB);
+#else
+    __uint128_t product = (__uint128_t)*pA * *pB;
+    *pA = (u64)product;
+    *pB = (u64)(product >> 64);
+#endif
+}
+
+// ***********************************************************************
+
+inline u64 HashMix(u64 a, u64 b) {
+    HashMultiply(&a, &b);
+    return a ^ b;
+}
+
+// ***********************************************************************
+
+inline u64 HashRead8(const u8* p) {
+    u64 value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+// ***********************************************************************
+
+inline u64 HashRead4(const u8* p) {
+    u32 value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+// ***********************************************************************
+
+inline u64 HashBytes(const void* pData, u64 length, u64 seed) {
+    const u64 secret[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+    const u8* p = (const u8*)pData;
+    seed ^= HashMix(seed ^ secret[0], secret[1]);
+
+    u64 a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            // two overlapping reads from each end cover every length from 4 to 16
+            u64 offset = (length >> 3) << 2;
+            a = (HashRead4(p) << 32) | HashRead4(p + offset);
+            b = (HashRead4(p + length - 4) << 32) | HashRead4(p + length - 4 - offset);
+        } else if (length > 0) {
+            a = (u64(p[0]) << 16) | (u64(p[length >> 1]) << 8) | u64(p[length - 1]);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        u64 remaining = length;
+        if (remaining > 48) {
+            // three independent lanes so the multiplies can overlap
+            u64 seed1 = seed;
+            u64 seed2 = seed;
+            do {
+                seed = HashMix(HashRead8(p) ^ secret[1], HashRead8(p + 8) ^ seed);
+                seed1 = HashMix(HashRead8(p + 16) ^ secret[2], HashRead8(p + 24) ^ seed1);
+                seed2 = HashMix(HashRead8(p + 32) ^ secret[3], HashRead8(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = HashMix(HashRead8(p) ^ secret[1], HashRead8(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = HashRead8(p + remaining - 16);
+        b = HashRead8(p + remaining - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    HashMultiply(&a, &b);
+    return HashMix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+// ***********************************************************************
+
 template<typename T>
 inline u64 KeyFuncs<T*>::Hash(T* key) const {
-    return u64(uintptr_t(key));
+    return HashInt(u64(uintptr_t(key)));
 }
 
 // ***********************************************************************
@@ -175,7 +359,7 @@ inline bool KeyFuncs<T*>::Cmp(T* key1, T* key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<char>::Hash(char key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -187,7 +371,7 @@ inline bool KeyFuncs<char>::Cmp(char key1, char key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<i8>::Hash(i8 key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -199,7 +383,7 @@ inline bool KeyFuncs<i8>::Cmp(i8 key1, i8 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<int16_t>::Hash(int16_t key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -211,7 +395,7 @@ inline bool KeyFuncs<int16_t>::Cmp(int16_t key1, int16_t key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<i32>::Hash(i32 key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -223,7 +407,7 @@ inline bool KeyFuncs<i32>::Cmp(i32 key1, i32 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<i64>::Hash(i64 key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -235,7 +419,7 @@ inline bool KeyFuncs<i64>::Cmp(i64 key1, i64 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<u8>::Hash(u8 key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -247,7 +431,7 @@ inline bool KeyFuncs<u8>::Cmp(u8 key1, u8 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<uint16_t>::Hash(uint16_t key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -259,7 +443,7 @@ inline bool KeyFuncs<uint16_t>::Cmp(uint16_t key1, uint16_t key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<u32>::Hash(u32 key) const {
-    return static_cast<u64>(key);
+    return HashInt(static_cast<u64>(key));
 }
 
 // ***********************************************************************
@@ -271,7 +455,7 @@ inline bool KeyFuncs<u32>::Cmp(u32 key1, u32 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<u64>::Hash(u64 key) const {
-    return key;
+    return HashInt(key);
 }
 
 // ***********************************************************************
@@ -283,7 +467,11 @@ inline bool KeyFuncs<u64>::Cmp(u64 key1, u64 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<f32>::Hash(f32 key) const {
-    return static_cast<u64>(key);
+    // hash the bits, casting to an integer would throw away the fraction. 0 and -0 compare equal so hash the same
+    u32 bits = 0;
+    if (key != 0.0f)
+        memcpy(&bits, &key, sizeof(f32));
+    return HashInt(bits);
 }
 
 // ***********************************************************************
@@ -295,7 +483,10 @@ inline bool KeyFuncs<f32>::Cmp(f32 key1, f32 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<f64>::Hash(f64 key) const {
-    return static_cast<u64>(key);
+    u64 bits = 0;
+    if (key != 0.0)
+        memcpy(&bits, &key, sizeof(f64));
+    return HashInt(bits);
 }
 
 // ***********************************************************************
@@ -307,12 +498,7 @@ inline bool KeyFuncs<f64>::Cmp(f64 key1, f64 key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<String>::Hash(const String& key) const {
-    u64 nbytes = key.length;
-    u64 hash = 0x811C9DC5;
-    const u8* pData = (const u8*)key.pData;
-    while (nbytes--)
-        hash = (*pData++ ^ hash) * 0x01000193;
-    return hash;
+    return HashBytes(key.pData, key.length);
 }
 
 // ***********************************************************************
@@ -324,11 +510,7 @@ inline bool KeyFuncs<String>::Cmp(const String& key1, const String& key2) const
 // ***********************************************************************
 
 inline u64 KeyFuncs<char*>::Hash(const char* key) const {
-    u32 c;
-    u32 hash = 0x811C9DC5;
-    while ((c = (u8)*key++) != 0)
-        hash = (c ^ hash) * 0x01000193;
-    return hash;
+    return HashBytes(key, strlen(key));
 }
 
 // ***********************************************************************
@@ -340,11 +522,7 @@ inline bool KeyFuncs<char*>::Cmp(const char* key1, const char* key2) const {
 // ***********************************************************************
 
 inline u64 KeyFuncs<const char*>::Hash(const char* key) const {
-    u32 c;
-    u32 hash = 0x811C9DC5;
-    while ((c = (u8)*key++) != 0)
-        hash = (c ^ hash) * 0x01000193;
-    return hash;
+    return HashBytes(key, strlen(key));
 }
 
 // ***********************************************************************
@@ -363,49 +541,130 @@ inline HashMap<K, V, KF>::HashMap(Arena* _pArena) {
 // ***********************************************************************
 
 template<typename K, typename V, typename KF>
-V& HashMap<K, V, KF>::Add(const K& key, const V& value) {
-    f32 loadFactor = tableSize == 0 ? INT_MAX : (f32)(count) / (f32)tableSize;
-    if (loadFactor >= 0.9f)
-        Rehash(tableSize + 1);
-
+inline u64 HashMap<K, V, KF>::HashKey(const K& key) const {
     u64 hash = keyFuncs.Hash(key);
-    if (hash < FIRST_VALID_HASH)
-        hash += FIRST_VALID_HASH;
-    u64 index = hash % tableSize;
-    u64 probeCounter = 1;
-
-    while (pTable[index].hash != UNUSED_HASH) {
-        index = (index + probeCounter) % tableSize;
-        probeCounter++;
-    }
+    return hash < FIRST_VALID_HASH ? hash + FIRST_VALID_HASH : hash;
+}
 
-    HashNode<K, V>& node = pTable[index];
-    node.hash = hash;
-    node.key = key;
-    node.value = value;
-    count++;
-    return node.value;
+// ***********************************************************************
+
+inline i64 HashProbeLength(u64 hash, i64 index, i64 tableSize) {
+    return (index - (i64)hash) & (tableSize - 1);
 }
 
 // ***********************************************************************
 
 template<typename K, typename V, typename KF>
-V* HashMap<K, V, KF>::Get(const K& key) {
+i64 HashFindIndex(const HashNode<K, V>* pNodes, i64 tableSize, const KF& keyFuncs, const K& key, u64 hash) {
     if (tableSize == 0)
-        return nullptr;
+        return -1;
+
+    i64 mask = tableSize - 1;
+    i64 index = hash & mask;
+    for (i64 distance = 0; pNodes[index].hash != UNUSED_HASH; distance++) {
+        // anything we're looking for would have displaced this node, so it isn't here
+        if (HashProbeLength(pNodes[index].hash, index, tableSize) < distance)
+            return -1;
+        if (pNodes[index].hash == hash && keyFuncs.Cmp(pNodes[index].key, key))
+            return index;
+        index = (index + 1) & mask;
+    }
+    return -1;
+}
 
-    u64 hash = keyFuncs.Hash(key);
-    if (hash < FIRST_VALID_HASH)
-        hash += FIRST_VALID_HASH;
-    u64 index = hash % tableSize;
-    u64 probeCounter = 1;
-
-    while (pTable[index].hash != UNUSED_HASH) {
-        if (keyFuncs.Cmp(pTable[index].key, key)) {
-            return &pTable[index].value;
+// ***********************************************************************
+
+template<typename K, typename V>
+void HashEraseIndex(HashNode<K, V>* pNodes, i64 tableSize, i64 index) {
+    // Shift the rest of the run back one, stopping at a gap or a node that's already home, that leaves the
+    // table exactly as if the erased key had never been added
+    i64 mask = tableSize - 1;
+    i64 next = (index + 1) & mask;
+    while (pNodes[next].hash != UNUSED_HASH && HashProbeLength(pNodes[next].hash, next, tableSize) > 0) {
+        pNodes[index] = pNodes[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+    memset(&pNodes[index], 0, sizeof(HashNode<K, V>));
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+inline i64 HashMap<K, V, KF>::ProbeLength(i64 index) const {
+    return HashProbeLength(pTable[index].hash, index, tableSize);
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+inline i64 HashMap<K, V, KF>::FindIndex(const K& key, u64 hash) const {
+    return HashFindIndex(pTable, tableSize, keyFuncs, key, hash);
+}
+
+// ***********************************************************************
+
+// Assumes there's room
+template<typename K, typename V, typename KF>
+V& HashMap<K, V, KF>::Insert(u64 hash, const K& key, const V& value) {
+    HashNode<K, V> carried;
+    carried.hash = hash;
+    carried.key = key;
+    carried.value = value;
+
+    i64 mask = tableSize - 1;
+    i64 index = hash & mask;
+    i64 distance = 0;
+    V* pResult = nullptr;
+    count++;
+    while (true) {
+        HashNode<K, V>& node = pTable[index];
+        if (node.hash == UNUSED_HASH) {
+            node = carried;
+            return pResult ? *pResult : node.value;
+        }
+
+        // take from the rich, the node closer to home moves on and we carry it instead
+        i64 nodeDistance = ProbeLength(index);
+        if (nodeDistance < distance) {
+            HashNode<K, V> displaced = node;
+            node = carried;
+            carried = displaced;
+            distance = nodeDistance;
+            if (pResult == nullptr)
+                pResult = &node.value;
         }
-        index = (index + probeCounter) % tableSize;
-        probeCounter++;
+        index = (index + 1) & mask;
+        distance++;
+    }
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+V& HashMap<K, V, KF>::Add(const K& key, const V& value) {
+    if (pOldTable)
+        RehashStep(rehashStep);
+
+    // max load of 7/8, robin hood keeps probes short up to around there
+    if ((count + 1) * 8 > tableSize * 7)
+        Rehash(tableSize + 1);
+
+    return Insert(HashKey(key), key, value);
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+V* HashMap<K, V, KF>::Get(const K& key) {
+    u64 hash = HashKey(key);
+    i64 index = FindIndex(key, hash);
+    if (index >= 0)
+        return &pTable[index].value;
+    if (pOldTable) {
+        index = HashFindIndex(pOldTable, oldTableSize, keyFuncs, key, hash);
+        if (index >= 0)
+            return &pOldTable[index].value;
     }
     return nullptr;
 }
@@ -414,30 +673,22 @@ V* HashMap<K, V, KF>::Get(const K& key) {
 
 template<typename K, typename V, typename KF>
 V& HashMap<K, V, KF>::GetOrAdd(const K& key) {
-    if (tableSize == 0) {
-        V value = V();
-        return Add(key, value);
+    if (pOldTable)
+        RehashStep(rehashStep);
+
+    u64 hash = HashKey(key);
+    i64 index = FindIndex(key, hash);
+    if (index >= 0)
+        return pTable[index].value;
+    if (pOldTable) {
+        index = HashFindIndex(pOldTable, oldTableSize, keyFuncs, key, hash);
+        if (index >= 0)
+            return pOldTable[index].value;
     }
 
-    f32 loadFactor = tableSize == 0 ? INT_MAX : (f32)(count) / (f32)tableSize;
-    if (loadFactor >= 0.9f)
+    if ((count + 1) * 8 > tableSize * 7)
         Rehash(tableSize + 1);
-
-    u64 hash = keyFuncs.Hash(key);
-    if (hash < FIRST_VALID_HASH)
-        hash += FIRST_VALID_HASH;
-    u64 index = hash % tableSize;
-    u64 probeCounter = 1;
-
-    while (pTable[index].hash != UNUSED_HASH) {
-        if (keyFuncs.Cmp(pTable[index].key, key)) {
-            return pTable[index].value;
-        }
-        index = (index + probeCounter) % tableSize;
-        probeCounter++;
-    }
-    V value = V();
-    return Add(key, value);
+    return Insert(hash, key, V());
 }
 
 // ***********************************************************************
@@ -459,52 +710,168 @@ void HashMap<K, V, KF>::Erase(const K& key) {
 template<typename K, typename V, typename KF>
 template<typename F>
 void HashMap<K, V, KF>::Erase(const K& key, F&& freeNode) {
-    if (tableSize == 0)
+    if (pOldTable)
+        RehashStep(rehashStep);
+
+    // runs in the old table are only ever moved whole, so what's left of it can be erased from as normal
+    u64 hash = HashKey(key);
+    HashNode<K, V>* pNodes = pTable;
+    i64 nodesSize = tableSize;
+    i64 index = FindIndex(key, hash);
+    if (index < 0 && pOldTable) {
+        pNodes = pOldTable;
+        nodesSize = oldTableSize;
+        index = HashFindIndex(pOldTable, oldTableSize, keyFuncs, key, hash);
+    }
+    if (index < 0)
         return;
 
-    u64 hash = keyFuncs.Hash(key);
-    if (hash < FIRST_VALID_HASH)
-        hash += FIRST_VALID_HASH;
-    u64 index = hash % tableSize;
-    u64 probeCounter = 1;
-
-    while (pTable[index].hash != UNUSED_HASH) {
-        if (keyFuncs.Cmp(pTable[index].key, key)) {
-            // Found the node
-            freeNode(pTable[index]);
-            memset(&pTable[index], 0, sizeof(HashNode<K, V>));
-            count--;
+    freeNode(pNodes[index]);
+    count--;
+    HashEraseIndex(pNodes, nodesSize, index);
+}
+
+// ***********************************************************************
+
+template<typename K, typename V>
+inline HashMapIterator<K, V>& HashMapIterator<K, V>::operator++() {
+    pNode++;
+    SkipUnused();
+    return *this;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V>
+inline void HashMapIterator<K, V>::SkipUnused() {
+    while (true) {
+        while (pNode != pEnd && pNode->hash == UNUSED_HASH)
+            pNode++;
+        if (pNode != pEnd || pNextTable == nullptr)
             return;
-        }
-        index = (index + probeCounter) % tableSize;
-        probeCounter++;
+        pNode = pNextTable;
+        pEnd = pNextEnd;
+        pNextTable = nullptr;
+    }
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+void HashMap<K, V, KF>::Reserve(i64 elementCount) {
+    // smallest table that holds this many under the 7/8 max load
+    i64 requiredTableSize = (elementCount * 8 + 6) / 7;
+    if (requiredTableSize > tableSize)
+        Rehash(requiredTableSize);
+    FinishRehash(); // whoever reserves is about to add a lot, better to pay for the move now
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+void HashMap<K, V, KF>::AddBulk(const K* pKeys, const V* pValues, i64 elementCount) {
+    Reserve(count + elementCount);
+    for (i64 i = 0; i < elementCount; i++) {
+        Insert(HashKey(pKeys[i]), pKeys[i], pValues[i]);
     }
 }
 
 // ***********************************************************************
 
+template<typename K, typename V, typename KF>
+void HashMap<K, V, KF>::Clear() {
+    if (pOldTable) {
+        if (releaseOldTables)
+            ArenaFree(pArena, pOldTable, oldTableSize * sizeof(HashNode<K, V>));
+        pOldTable = nullptr;
+        oldTableSize = 0;
+    }
+    if (pTable)
+        memset(pTable, 0, tableSize * sizeof(HashNode<K, V>));
+    count = 0;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+HashMapIterator<K, V> HashMap<K, V, KF>::begin() {
+    HashMapIterator<K, V> it { pTable, pTable + tableSize, pOldTable, pOldTable + oldTableSize };
+    it.SkipUnused();
+    return it;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+HashMapIterator<K, V> HashMap<K, V, KF>::end() {
+    HashNode<K, V>* pLast = pOldTable ? pOldTable + oldTableSize : pTable + tableSize;
+    return HashMapIterator<K, V> { pLast, pLast, nullptr, nullptr };
+}
+
+// ***********************************************************************
+
 template<typename K, typename V, typename KF>
 void HashMap<K, V, KF>::Rehash(i64 requiredTableSize) {
     if (requiredTableSize < tableSize)
         return;
+    FinishRehash();
 
-    HashNode<K, V>* pTableOld = pTable;
-
-    // f64 the table size until we can fit required table size
-    constexpr u64 minTableSize = 32;
-    u64 newTableSize = tableSize == 0 ? minTableSize : tableSize * 2;
+    // double the table size until we can fit required table size
+    constexpr i64 minTableSize = 32;
+    i64 newTableSize = minTableSize;
     while (newTableSize < (requiredTableSize > minTableSize ? requiredTableSize : minTableSize))
         newTableSize *= 2;
 
-	pTable = (HashNode<K, V>*)ArenaAlloc(pArena, sizeof(HashNode<K, V>)*newTableSize, alignof(HashNode<K, V>), false); 
-    memset(pTable, 0, newTableSize * sizeof(HashNode<K, V>));
-
-    u64 oldTableSize = tableSize;
+    pOldTable = pTable;
+    oldTableSize = tableSize;
+    pTable = (HashNode<K, V>*)ArenaAllocReleasable(pArena, sizeof(HashNode<K, V>) * newTableSize, alignof(HashNode<K, V>));
     tableSize = newTableSize;
-    for (int i = 0; i < oldTableSize; i++) {
-        if (pTableOld[i].hash != UNUSED_HASH) {
-            Add(pTableOld[i].key, pTableOld[i].value);
-            count--;
+    if (pOldTable == nullptr)
+        return;
+
+    // there's always a gap under the max load
+    migrateStart = 0;
+    while (pOldTable[migrateStart].hash != UNUSED_HASH)
+        migrateStart++;
+    migrated = 0;
+    if (rehashStep == 0)
+        FinishRehash();
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+void HashMap<K, V, KF>::RehashStep(i64 slots) {
+    if (pOldTable == nullptr)
+        return;
+
+    // moved keys only need clearing if lookups are going to check the old table again, when it's all going in one
+    // go it's left as it was for any copies of the map still reading it
+    bool finishing = slots >= oldTableSize - migrated;
+    i64 mask = oldTableSize - 1;
+    for (i64 moved = 0; migrated < oldTableSize; moved++, migrated++) {
+        HashNode<K, V>& node = pOldTable[(migrateStart + migrated) & mask];
+        if (node.hash == UNUSED_HASH) {
+            // only stop at a gap, a half moved run would hide the rest of it from lookups in the old table
+            if (moved >= slots)
+                return;
+            continue;
         }
+        count--; // Insert counts it again
+        Insert(node.hash, node.key, node.value);
+        if (!finishing)
+            node.hash = UNUSED_HASH;
     }
+
+    if (releaseOldTables)
+        ArenaFree(pArena, pOldTable, oldTableSize * sizeof(HashNode<K, V>));
+    pOldTable = nullptr;
+    oldTableSize = 0;
+}
+
+// ***********************************************************************
+
+template<typename K, typename V, typename KF>
+void HashMap<K, V, KF>::FinishRehash() {
+    RehashStep(oldTableSize);
 }
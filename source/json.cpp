@@ -42,14 +42,14 @@ struct Token {
 
 // ***********************************************************************
 
-ResizableArray<Token> TokenizeJson(Arena* pArena, String jsonText) {
+ResizableArray<Token> TokenizeJson(Arena* pArena, Arena* pTokenArena, String jsonText) {
     Scan::ScanningState scan;
     scan.pTextStart = jsonText.pData;
     scan.pTextEnd = jsonText.pData + jsonText.length;
     scan.pCurrent = (char*)scan.pTextStart;
     scan.line = 1;
     
-    ResizableArray<Token> tokens(pArena);
+    ResizableArray<Token> tokens(pTokenArena);
     
     while (!Scan::IsAtEnd(scan)) {
         char c = Scan::Advance(scan);
@@ -400,7 +400,9 @@ JsonValue JsonValue::NewArray() {
 // ***********************************************************************
 
 JsonValue ParseJsonFile(Arena* pArena, String file) {
-    ResizableArray<Token> tokens = TokenizeJson(pArena, file);
+    // The token list is only needed during parsing, strings it points to are allocated in pArena though
+    ScratchScope(scratch, pArena);
+    ResizableArray<Token> tokens = TokenizeJson(pArena, scratch.pArena, file);
     
     int firstToken = 0;
     JsonValue json5 = ParseValue(pArena, tokens, firstToken);
@@ -435,14 +437,11 @@ void SerializeJsonInternal(JsonValue json, StringBuilder& builder, int indentCou
             if (json.Count() > 0)
                 builder.Append("\n");
             
-            for (i64 i = 0; i < json.object.tableSize; i++) {
-                HashNode<String, JsonValue>& node = json.object.pTable[i];
-                if (node.hash != UNUSED_HASH) {
-                    printIndentation(indentCount + 1);
-                    builder.AppendFormat("\"%s\" : ", node.key.pData);
-                    SerializeJsonInternal(node.value, builder, indentCount + 1);
-                    builder.Append(", \n");
-                }
+            for (HashNode<String, JsonValue>& node : json.object) {
+                printIndentation(indentCount + 1);
+                builder.AppendFormat("\"%s\" : ", node.key.pData);
+                SerializeJsonInternal(node.value, builder, indentCount + 1);
+                builder.Append(", \n");
             }
             
             printIndentation(indentCount);
@@ -170,20 +170,26 @@ String ChopRight(String str, i64 n) {
 // ***********************************************************************
 
 ResizableArray<String> Split(Arena* pArena, String str, String splitChars) {
-	ResizableArray<String> result;
-	result.pArena = pArena;
+	// Grow the array in scratch memory, so the output arena only gets the final exactly sized copy
+	ScratchScope(scratch, pArena);
+	ResizableArray<String> parts(scratch.pArena);
 
 	i64 lastSeparation = 0;
 	for(i64 i = 0; i < str.length; i++) {
 		for (i64 j = 0; j < splitChars.length; j++) {
 			if (str[i] == splitChars[j]) {
-				result.PushBack(SubStr(str, lastSeparation, i - lastSeparation));
+				parts.PushBack(SubStr(str, lastSeparation, i - lastSeparation));
 				lastSeparation = i+1;
 				continue;
 			}
 		}
 	}
-	result.PushBack(SubStr(str, lastSeparation, str.length - lastSeparation));
+	parts.PushBack(SubStr(str, lastSeparation, str.length - lastSeparation));
+
+	ResizableArray<String> result(pArena);
+	result.Reserve(parts.count);
+	memcpy(result.pData, parts.pData, parts.count * sizeof(String));
+	result.count = parts.count;
 	return result;
 }
 
@@ -262,7 +268,8 @@ i64 Find(String str, String substr) {
 // ***********************************************************************
 
 String Join(Arena* pArena, ResizableArray<String> parts, String separator) {
-	StringBuilder builder(g_pArenaFrame);
+	ScratchScope(scratch, pArena);
+	StringBuilder builder(scratch.pArena);
 	for (int i=0; i<parts.count; i++) {
 		builder.Append(parts[i]);
 		if (i<parts.count-1) {
@@ -1,5 +1,11 @@
 // Copyright 2020-2022 David Colson. All rights reserved.
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
 // ***********************************************************************
 
 namespace Log {
@@ -9,34 +15,57 @@ FILE* g_pLogFile { nullptr };
 
 // ***********************************************************************
 
-void PushLogMessage(LogLevel level, String message) {
+FILE* OpenLogFile(const char* path, const char* mode) {
+#ifdef _WIN32
+    FILE* pFile = nullptr;
+    fopen_s(&pFile, path, mode);
+    return pFile;
+#else
+    return fopen(path, mode);
+#endif
+}
+
+// ***********************************************************************
+
+// The debugger's output window, off windows there's no such thing so stderr stands in for it
+void DebuggerOutput(const char* message) {
+#ifdef _WIN32
+    OutputDebugStringA(message);
+#else
+    fputs(message, stderr);
+#endif
+}
+
+// ***********************************************************************
+
+void PushLogMessage(LogLevel level, String message, u64 traceSkip = 2) {
     if (level > g_logLevel)
         return;
 
     if (g_config.fileOutput) {
         if (g_pLogFile == nullptr)
-            fopen_s(&g_pLogFile, "application.log", "w");
-        fprintf(g_pLogFile, message.pData);
+            g_pLogFile = OpenLogFile("application.log", "w");
+        fputs(message.pData, g_pLogFile);
         fflush(g_pLogFile);
     }
 
     if (g_config.winOutput)
-        OutputDebugStringA(message.pData);
+        DebuggerOutput(message.pData);
 
     if (g_config.consoleOutput)
         printf("%s", message.pData);
 
     if (level <= Log::ECrit) {
         void* trace[100];
-        u64 frames = Debug::CollectStackTrace(trace, 100, 2);
+        u64 frames = Debug::CollectStackTrace(trace, 100, traceSkip);
 
-        String stackTrace = Debug::PrintStackTraceToString(trace, frames, g_pArenaFrame);
+        String stackTrace = g_config.symbolizeCritTraces ? Debug::PrintStackTraceToString(trace, frames, g_pArenaFrame) : Debug::PrintStackTraceRaw(trace, frames, g_pArenaFrame);
         if (g_config.fileOutput) {
-            fprintf(g_pLogFile, stackTrace.pData);
+            fputs(stackTrace.pData, g_pLogFile);
             fflush(g_pLogFile);
         }
         if (g_config.winOutput)
-            OutputDebugStringA(stackTrace.pData);
+            DebuggerOutput(stackTrace.pData);
         if (g_config.consoleOutput)
             printf("%s", stackTrace.pData);
     }
@@ -48,14 +77,952 @@ void PushLogMessage(LogLevel level, String message) {
         g_config.customHandler2(level, message);
 
     if (g_config.critCrashes && level <= Log::ECrit)
-        __debugbreak();
+        DEBUG_BREAK();
+}
+
+// Async output
+// ---------------------
+// Messages are still formatted on the calling thread, but then they're just copied into that thread's own ring
+// buffer. A background writer drains every ring in one go each flush interval, so the file/console writes and
+// the flush are paid once per batch, and never by the thread that logged
+
+#define LOG_RING_WRAP 0xffffffff
+
+struct LogRecord {
+    i64 sequence; // global order, so messages from different threads come out in the order they were logged
+    u32 length;   // LOG_RING_WRAP means the rest of the ring is unused, continue from the start
+    u16 level;
+    u16 binary;   // payload is a BinaryLogEntry and arguments rather than text
+};
+
+struct LogRing {
+    LogRing* pNext;
+    u8* pBuffer;
+    i64 capacity;          // power of two
+    volatile i64 writePos; // only ever moved by the owning thread
+    volatile i64 readPos;  // only ever moved by whoever holds g_asyncLock
+    volatile i64 dropped;
+};
+
+static LogRing* g_pLogRings { nullptr };
+static SpinLock g_asyncLock;
+static volatile i64 g_logSequence { 0 };
+static volatile i32 g_writerStarted { 0 };
+thread_local LogRing* t_pLogRing { nullptr };
+thread_local bool t_holdsAsyncLock { false }; // the lock isn't reentrant, an assert or crit inside it mustn't flush
+
+// ***********************************************************************
+
+void AsyncLockAcquire() {
+    SpinLockAcquire(g_asyncLock);
+    t_holdsAsyncLock = true;
+}
+
+// ***********************************************************************
+
+void AsyncLockRelease() {
+    t_holdsAsyncLock = false;
+    SpinLockRelease(g_asyncLock);
+}
+
+// Binary output
+// ---------------------
+// Nothing is formatted when logging, the caller copies the format string pointer, a timestamp and the raw
+// argument values into its ring. The writer puts each format string in the file the first time it sees it, and
+// after that messages only refer to it by address, so DecodeBinaryLog can render the text later.
+//
+// File layout, little endian and unaligned:
+//   header:  "CLBINLOG", u64 timestamp frequency
+//   entries: u8 type, then
+//     BLE_FORMAT   u64 format id, u32 length, chars (category names go in here too)
+//     BLE_MESSAGE  u8 level, u64 timestamp, u64 format id, u64 category id (0 for none), u32 arguments length, arguments
+//     BLE_DROPPED  u64 count
+// Each argument ('*' widths and precisions too) is 8 bytes, integers widened to 64 bits and floats as f64.
+// Strings are a u32 length and the chars
+
+#define BINARY_LOG_MAGIC "CLBINLOG"
+#define BINARY_LOG_MAX_ARGUMENTS 1024
+
+enum BinaryLogEntryType : u8 {
+    BLE_FORMAT = 1,
+    BLE_MESSAGE,
+    BLE_DROPPED
+};
+
+struct BinaryLogEntry {
+    u64 timestamp;
+    const char* pFormat;
+    const char* pCategory;
+    // followed by the encoded arguments
+};
+
+static FILE* g_pBinaryLogFile { nullptr };
+static Arena* g_pBinaryLogArena { nullptr };
+static HashMap<u64, bool> g_binaryLogFormats(nullptr); // formats already written to the file
+
+// ***********************************************************************
+
+const char* LevelPrefix(LogLevel level) {
+    switch (level) {
+        case EAssert: return "[ASSERT FAIL] ";
+        case ECrit: return "[CRITICAL] ";
+        case EWarn: return "[WARNING] ";
+        case EInfo: return "[INFO] ";
+        default: return "[DEBUG] ";
+    }
+}
+
+// ***********************************************************************
+
+void AppendPrefix(StringBuilder& builder, LogLevel level, const char* category) {
+    builder.Append(LevelPrefix(level));
+    if (category) {
+        builder.Append("[");
+        builder.Append(category);
+        builder.Append("] ");
+    }
+}
+
+// ***********************************************************************
+
+u64 GetLogTimestamp() {
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return u64(time.tv_sec) * 1000000000ull + u64(time.tv_nsec);
+#endif
+}
+
+// ***********************************************************************
+
+u64 GetLogTimestampFrequency() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+#else
+    return 1000000000ull;
+#endif
+}
+
+// ***********************************************************************
+
+struct FormatSpec {
+    i32 length;        // from the '%' up to and including the conversion
+    i32 sizeOffset;    // where the size modifier starts (or the conversion if there isn't one)
+    char conversion;   // 0 if the format ended before one
+    char size;         // 'H' hh, 'h', 'l', 'q' ll or I64, 'j', 'z', 't', 'L', or 0
+    i32 starCount;     // '*' widths and precisions, each takes an int argument
+    bool hasPrecision;
+    i32 precision;     // only when written in the format
+};
+
+// pFormat points at the '%'
+FormatSpec ParseFormatSpec(const char* pFormat) {
+    FormatSpec spec = {};
+    const char* p = pFormat + 1;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+        p++;
+
+    if (*p == '*') {
+        spec.starCount++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+
+    if (*p == '.') {
+        p++;
+        spec.hasPrecision = true;
+        if (*p == '*') {
+            spec.starCount++;
+            spec.precision = -1;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            spec.precision = spec.precision * 10 + (*p++ - '0');
+    }
+
+    spec.sizeOffset = i32(p - pFormat);
+    if (*p == 'h') {
+        p++;
+        spec.size = 'h';
+        if (*p == 'h') {
+            p++;
+            spec.size = 'H';
+        }
+    } else if (*p == 'l') {
+        p++;
+        spec.size = 'l';
+        if (*p == 'l') {
+            p++;
+            spec.size = 'q';
+        }
+    } else if (p[0] == 'I' && p[1] == '6' && p[2] == '4') {
+        p += 3;
+        spec.size = 'q';
+    } else if (*p == 'j' || *p == 'z' || *p == 't' || *p == 'L') {
+        spec.size = *p++;
+    }
+
+    spec.conversion = *p;
+    spec.length = i32(p - pFormat) + (*p ? 1 : 0);
+    return spec;
+}
+
+// ***********************************************************************
+
+// Copies the arguments a format string uses into pOut, returns how many bytes it took. Anything that doesn't fit
+// is left off, and the decoder prints the rest of the format as is
+i64 EncodeArguments(u8* pOut, i64 capacity, const char* format, va_list arguments) {
+    u8* pCursor = pOut;
+    u8* pEnd = pOut + capacity;
+    while (*format) {
+        if (*format != '%') {
+            format++;
+            continue;
+        }
+        FormatSpec spec = ParseFormatSpec(format);
+        format += spec.length;
+        if (spec.conversion == '%')
+            continue;
+        if (spec.conversion == 0)
+            break;
+
+        // all va_arg calls stay in this function, a va_list can't be handed down and still advance on every platform
+        i64 stars[2] = { 0, -1 };
+        for (i32 i = 0; i < spec.starCount; i++) {
+            stars[i] = va_arg(arguments, int);
+        }
+
+        i64 value = 0;
+        switch (spec.conversion) {
+            case 'd':
+            case 'i':
+                switch (spec.size) {
+                    case 'H': value = (signed char)va_arg(arguments, int); break;
+                    case 'h': value = (short)va_arg(arguments, int); break;
+                    case 'l': value = va_arg(arguments, long); break;
+                    case 'q': value = va_arg(arguments, long long); break;
+                    case 'j': value = va_arg(arguments, intmax_t); break;
+                    case 'z': value = (i64)va_arg(arguments, size_t); break;
+                    case 't': value = va_arg(arguments, intptr_t); break;
+                    default: value = va_arg(arguments, int); break;
+                }
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                switch (spec.size) {
+                    case 'H': value = (unsigned char)va_arg(arguments, unsigned int); break;
+                    case 'h': value = (unsigned short)va_arg(arguments, unsigned int); break;
+                    case 'l': value = va_arg(arguments, unsigned long); break;
+                    case 'q': value = va_arg(arguments, unsigned long long); break;
+                    case 'j': value = va_arg(arguments, uintmax_t); break;
+                    case 'z': value = va_arg(arguments, size_t); break;
+                    case 't': value = va_arg(arguments, intptr_t); break;
+                    default: value = va_arg(arguments, unsigned int); break;
+                }
+                break;
+            case 'c':
+                value = va_arg(arguments, int);
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                f64 real = spec.size == 'L' ? (f64)va_arg(arguments, long double) : va_arg(arguments, double);
+                memcpy(&value, &real, sizeof(f64));
+                break;
+            }
+            case 'p':
+            case 'n':
+                value = (i64)va_arg(arguments, void*);
+                break;
+            case 's':
+            case 'S': {
+                const char* pChars;
+                i64 length;
+                if (spec.conversion == 'S') {
+                    String str = va_arg(arguments, String);
+                    pChars = str.pData;
+                    length = str.length;
+                } else {
+                    pChars = va_arg(arguments, const char*);
+                    if (pChars == nullptr)
+                        pChars = "(null)";
+                    // a precision means the string might not be terminated
+                    i64 precision = spec.precision >= 0 ? spec.precision : stars[spec.starCount - 1];
+                    if (spec.hasPrecision && precision >= 0) {
+                        length = 0;
+                        while (length < precision && pChars[length])
+                            length++;
+                    } else {
+                        length = strlen(pChars);
+                    }
+                }
+                if (pEnd - pCursor < (i64)sizeof(u32) + spec.starCount * 8)
+                    return pCursor - pOut;
+                for (i32 i = 0; i < spec.starCount; i++) {
+                    memcpy(pCursor, &stars[i], 8);
+                    pCursor += 8;
+                }
+                if (length > pEnd - pCursor - (i64)sizeof(u32))
+                    length = pEnd - pCursor - (i64)sizeof(u32);
+                u32 length32 = (u32)length;
+                memcpy(pCursor, &length32, sizeof(u32));
+                memcpy(pCursor + sizeof(u32), pChars, length);
+                pCursor += sizeof(u32) + length;
+                continue;
+            }
+            default:
+                return pCursor - pOut; // not something we understand, can't know what else is on the stack
+        }
+        if (spec.conversion == 'n')
+            continue;
+
+        if (pEnd - pCursor < (spec.starCount + 1) * 8)
+            return pCursor - pOut;
+        for (i32 i = 0; i < spec.starCount; i++) {
+            memcpy(pCursor, &stars[i], 8);
+            pCursor += 8;
+        }
+        memcpy(pCursor, &value, 8);
+        pCursor += 8;
+    }
+    return pCursor - pOut;
+}
+
+// ***********************************************************************
+
+template<typename T>
+void AppendFormattedValue(StringBuilder& builder, const char* spec, i64* pStars, i32 starCount, T value) {
+    i32 addedLength;
+    switch (starCount) {
+        case 0: addedLength = snprintf(nullptr, 0, spec, value); break;
+        case 1: addedLength = snprintf(nullptr, 0, spec, (int)pStars[0], value); break;
+        default: addedLength = snprintf(nullptr, 0, spec, (int)pStars[0], (int)pStars[1], value); break;
+    }
+    if (addedLength <= 0)
+        return;
+
+    builder.Reserve(builder.GrowCapacity(builder.length + addedLength + 1));
+    char* pOut = builder.pData + builder.length;
+    switch (starCount) {
+        case 0: snprintf(pOut, addedLength + 1, spec, value); break;
+        case 1: snprintf(pOut, addedLength + 1, spec, (int)pStars[0], value); break;
+        default: snprintf(pOut, addedLength + 1, spec, (int)pStars[0], (int)pStars[1], value); break;
+    }
+    builder.length += addedLength;
+}
+
+// ***********************************************************************
+
+// Inverse of EncodeArguments, formats one message from its format string and encoded arguments
+void DecodeMessage(StringBuilder& builder, const char* format, const u8* pArguments, i64 argumentsLength) {
+    const u8* pCursor = pArguments;
+    const u8* pEnd = pArguments + argumentsLength;
+    while (*format) {
+        if (*format != '%') {
+            const char* pText = format;
+            while (*format && *format != '%')
+                format++;
+            builder.AppendChars(pText, format - pText);
+            continue;
+        }
+
+        FormatSpec spec = ParseFormatSpec(format);
+        if (spec.conversion == '%') {
+            builder.Append("%");
+            format += spec.length;
+            continue;
+        }
+        if (spec.conversion == 'n') {
+            format += spec.length;
+            continue;
+        }
+
+        bool isString = spec.conversion == 's' || spec.conversion == 'S';
+        i64 needed = spec.starCount * 8 + (isString ? (i64)sizeof(u32) : 8);
+        if (spec.conversion == 0 || spec.sizeOffset > 48 || pEnd - pCursor < needed) {
+            // ran out of arguments (or the format is broken), show what's left as it was written
+            builder.Append(format);
+            return;
+        }
+
+        i64 stars[2] = {};
+        for (i32 i = 0; i < spec.starCount; i++) {
+            memcpy(&stars[i], pCursor, 8);
+            pCursor += 8;
+        }
+
+        // Same flags, width and precision, but with the size modifier swapped for how the value was stored
+        char specFormat[64];
+        memcpy(specFormat, format, spec.sizeOffset);
+        i32 specLength = spec.sizeOffset;
+        char conversion = spec.conversion;
+        switch (conversion) {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                specFormat[specLength++] = 'l';
+                specFormat[specLength++] = 'l';
+                break;
+            case 'S':
+                conversion = 's';
+                break;
+            default:
+                break;
+        }
+        specFormat[specLength++] = conversion;
+        specFormat[specLength] = 0;
+        format += spec.length;
+
+        if (isString) {
+            u32 length;
+            memcpy(&length, pCursor, sizeof(u32));
+            pCursor += sizeof(u32);
+            if (length > pEnd - pCursor)
+                length = u32(pEnd - pCursor);
+
+            ScratchScope(scratch, builder.pArena);
+            char* pChars = (char*)ArenaAlloc(scratch.pArena, length + 1, 1, true);
+            memcpy(pChars, pCursor, length);
+            pChars[length] = 0;
+            pCursor += length;
+            AppendFormattedValue(builder, specFormat, stars, spec.starCount, (const char*)pChars);
+            continue;
+        }
+
+        i64 value;
+        memcpy(&value, pCursor, 8);
+        pCursor += 8;
+        switch (conversion) {
+            case 'd':
+            case 'i':
+                AppendFormattedValue(builder, specFormat, stars, spec.starCount, (long long)value);
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                AppendFormattedValue(builder, specFormat, stars, spec.starCount, (unsigned long long)value);
+                break;
+            case 'c':
+                AppendFormattedValue(builder, specFormat, stars, spec.starCount, (int)value);
+                break;
+            case 'p':
+                AppendFormattedValue(builder, specFormat, stars, spec.starCount, (void*)value);
+                break;
+            default: {
+                f64 real;
+                memcpy(&real, &value, sizeof(f64));
+                AppendFormattedValue(builder, specFormat, stars, spec.starCount, real);
+                break;
+            }
+        }
+    }
+}
+
+// ***********************************************************************
+
+LogRing* CreateLogRing() {
+    i64 capacity = 4096;
+    while (capacity < g_config.asyncBufferSize)
+        capacity *= 2;
+
+    // one allocation, the ring lives until its thread calls ThreadRingRelease
+    u8* pMemory = VirtualReserve(sizeof(LogRing) + capacity);
+    VirtualCommit(pMemory, sizeof(LogRing) + capacity);
+    LogRing* pRing = (LogRing*)pMemory;
+    pRing->pBuffer = pMemory + sizeof(LogRing);
+    pRing->capacity = capacity;
+
+    i64 head;
+    do {
+        head = AtomicLoad((volatile i64*)&g_pLogRings);
+        pRing->pNext = (LogRing*)head;
+    } while (!AtomicCompareExchange((volatile i64*)&g_pLogRings, head, (i64)pRing));
+
+    t_pLogRing = pRing;
+    return pRing;
+}
+
+// ***********************************************************************
+
+LogRecord* PeekRecord(LogRing* pRing, i64 writePos) {
+    while (pRing->readPos < writePos) {
+        i64 offset = pRing->readPos & (pRing->capacity - 1);
+        LogRecord* pRecord = (LogRecord*)(pRing->pBuffer + offset);
+        if (pRing->capacity - offset < (i64)sizeof(LogRecord) || pRecord->length == LOG_RING_WRAP) {
+            AtomicStore(&pRing->readPos, pRing->readPos + pRing->capacity - offset);
+            continue;
+        }
+        return pRecord;
+    }
+    return nullptr;
+}
+
+// ***********************************************************************
+
+// Must hold g_asyncLock
+void OpenBinaryLog(StringBuilder& binaryBatch) {
+    if (g_pBinaryLogFile)
+        return;
+    g_pBinaryLogFile = OpenLogFile("application.binlog", "wb");
+    u64 frequency = GetLogTimestampFrequency();
+    binaryBatch.AppendChars(BINARY_LOG_MAGIC, 8);
+    binaryBatch.AppendChars((char*)&frequency, sizeof(u64));
+
+    g_pBinaryLogArena = ArenaCreate(DEFAULT_RESERVE, true);
+    g_binaryLogFormats.pArena = g_pBinaryLogArena;
+}
+
+// ***********************************************************************
+
+// Must hold g_asyncLock
+void WriteBinaryLogString(StringBuilder& binaryBatch, const char* string) {
+    u64 id = (u64)string;
+    if (string == nullptr || g_binaryLogFormats.Get(id))
+        return;
+    g_binaryLogFormats.Add(id, true);
+    u8 type = BLE_FORMAT;
+    u32 length = (u32)strlen(string);
+    binaryBatch.AppendChars((char*)&type, 1);
+    binaryBatch.AppendChars((char*)&id, sizeof(u64));
+    binaryBatch.AppendChars((char*)&length, sizeof(u32));
+    binaryBatch.AppendChars(string, length);
+}
+
+// ***********************************************************************
+
+// Must hold g_asyncLock
+void WriteBinaryLogEntry(StringBuilder& binaryBatch, LogLevel level, BinaryLogEntry* pEntry, u8* pArguments, u32 argumentsLength) {
+    OpenBinaryLog(binaryBatch);
+    WriteBinaryLogString(binaryBatch, pEntry->pFormat);
+    WriteBinaryLogString(binaryBatch, pEntry->pCategory);
+
+    u8 type = BLE_MESSAGE;
+    u8 level8 = (u8)level;
+    u64 formatId = (u64)pEntry->pFormat;
+    u64 categoryId = (u64)pEntry->pCategory;
+    binaryBatch.AppendChars((char*)&type, 1);
+    binaryBatch.AppendChars((char*)&level8, 1);
+    binaryBatch.AppendChars((char*)&pEntry->timestamp, sizeof(u64));
+    binaryBatch.AppendChars((char*)&formatId, sizeof(u64));
+    binaryBatch.AppendChars((char*)&categoryId, sizeof(u64));
+    binaryBatch.AppendChars((char*)&argumentsLength, sizeof(u32));
+    binaryBatch.AppendChars((char*)pArguments, argumentsLength);
+}
+
+// ***********************************************************************
+
+// Must hold g_asyncLock
+void DrainLogRings() {
+    ScratchScope(scratch, nullptr);
+    StringBuilder batch(scratch.pArena);       // text log file
+    StringBuilder binaryBatch(scratch.pArena); // binary log file
+    StringBuilder display(scratch.pArena);     // console and debugger, text of both kinds
+    bool displayOutput = g_config.consoleOutput || g_config.winOutput;
+    bool handlers = g_config.customHandler1 || g_config.customHandler2;
+
+    // Only take what was written up to now, so a busy thread can't keep us here forever
+    LogRing* pRings = (LogRing*)AtomicLoad((volatile i64*)&g_pLogRings);
+    ResizableArray<i64> writePositions(scratch.pArena);
+    i64 totalDropped = 0;
+    for (LogRing* pRing = pRings; pRing; pRing = pRing->pNext) {
+        writePositions.PushBack(AtomicLoad(&pRing->writePos));
+        totalDropped += AtomicExchange(&pRing->dropped, 0);
+    }
+    if (totalDropped > 0) {
+        String note = StringPrint(scratch.pArena, "[LOG] %lli messages dropped, a ring buffer was full\n", totalDropped);
+        display.Append(note);
+        if (g_config.binaryOutput && g_config.fileOutput) {
+            OpenBinaryLog(binaryBatch);
+            u8 type = BLE_DROPPED;
+            binaryBatch.AppendChars((char*)&type, 1);
+            binaryBatch.AppendChars((char*)&totalDropped, sizeof(i64));
+        } else {
+            batch.Append(note);
+        }
+    }
+
+    // Every ring is already in order, merge them so the output is too
+    while (true) {
+        LogRing* pOldestRing = nullptr;
+        LogRecord* pOldest = nullptr;
+        i64 i = 0;
+        for (LogRing* pRing = pRings; pRing && i < writePositions.count; pRing = pRing->pNext, i++) {
+            LogRecord* pRecord = PeekRecord(pRing, writePositions[i]);
+            if (pRecord && (pOldest == nullptr || pRecord->sequence < pOldest->sequence)) {
+                pOldest = pRecord;
+                pOldestRing = pRing;
+            }
+        }
+        if (pOldest == nullptr)
+            break;
+
+        // copy it out, once readPos moves the owning thread is free to overwrite the record
+        LogLevel level = LogLevel(pOldest->level);
+        bool binary = pOldest->binary != 0;
+        u32 length = pOldest->length;
+        u8* pPayload = (u8*)ArenaAlloc(scratch.pArena, length + 1, 8, true);
+        memcpy(pPayload, pOldest + 1, length);
+        pPayload[length] = 0;
+        AtomicStore(&pOldestRing->readPos, pOldestRing->readPos + (i64)Align(sizeof(LogRecord) + length, 8));
+
+        String message;
+        if (binary) {
+            BinaryLogEntry* pEntry = (BinaryLogEntry*)pPayload;
+            u8* pArguments = pPayload + sizeof(BinaryLogEntry);
+            u32 argumentsLength = length - sizeof(BinaryLogEntry);
+            if (g_config.fileOutput)
+                WriteBinaryLogEntry(binaryBatch, level, pEntry, pArguments, argumentsLength);
+
+            // only pay for formatting if something is going to look at the text right now
+            if (!displayOutput && !handlers)
+                continue;
+            StringBuilder builder(scratch.pArena);
+            if (!g_config.silencePrefixes) AppendPrefix(builder, level, pEntry->pCategory);
+            DecodeMessage(builder, pEntry->pFormat, pArguments, argumentsLength);
+            builder.Append("\n");
+            message = builder.CreateString(scratch.pArena);
+        } else {
+            message.pData = (char*)pPayload;
+            message.length = length;
+            batch.Append(message);
+        }
+
+        if (displayOutput)
+            display.Append(message);
+        if (g_config.customHandler1)
+            g_config.customHandler1(level, message);
+        if (g_config.customHandler2)
+            g_config.customHandler2(level, message);
+    }
+
+    if (g_config.fileOutput && batch.length > 0) {
+        if (g_pLogFile == nullptr)
+            g_pLogFile = OpenLogFile("application.log", "w");
+        fwrite(batch.pData, 1, batch.length, g_pLogFile);
+        fflush(g_pLogFile);
+    }
+    if (binaryBatch.length > 0) {
+        fwrite(binaryBatch.pData, 1, binaryBatch.length, g_pBinaryLogFile);
+        fflush(g_pBinaryLogFile);
+    }
+    if (display.length == 0)
+        return;
+    if (g_config.winOutput)
+        DebuggerOutput(display.pData);
+    if (g_config.consoleOutput)
+        fwrite(display.pData, 1, display.length, stdout);
+}
+
+// ***********************************************************************
+
+void LogWriterLoop() {
+    while (true) {
+        AsyncLockAcquire();
+        DrainLogRings();
+        u32 interval = g_config.asyncFlushIntervalMs;
+        AsyncLockRelease();
+#ifdef _WIN32
+        Sleep(interval);
+#else
+        usleep(interval * 1000);
+#endif
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI LogWriterThread(LPVOID) {
+    LogWriterLoop();
+    return 0;
+}
+#else
+void* LogWriterThread(void*) {
+    LogWriterLoop();
+    return nullptr;
+}
+#endif
+
+// ***********************************************************************
+
+void StartLogWriter() {
+    if (AtomicExchange(&g_writerStarted, 1) != 0)
+        return;
+
+#ifdef _WIN32
+    CloseHandle(CreateThread(nullptr, 0, LogWriterThread, nullptr, 0, nullptr));
+#else
+    pthread_t thread;
+    pthread_create(&thread, nullptr, LogWriterThread, nullptr);
+    pthread_detach(thread);
+#endif
+    // whatever is still buffered when the program ends would otherwise be lost
+    atexit([] { Log::Flush(); });
+}
+
+// ***********************************************************************
+
+// Makes room for a record in this thread's ring, returns null if it had to be dropped. The record is published
+// by moving writePos to writeEnd once it's filled in
+LogRecord* BeginLogRecord(LogRing* pRing, LogLevel level, u32 length, bool binary, i64& writeEnd) {
+    i64 recordSize = Align(sizeof(LogRecord) + length, 8);
+
+    i64 offset;
+    i64 padding;
+    while (true) {
+        // a record never wraps, if it doesn't fit before the end of the ring we skip to the start. Worked out again
+        // each time round, a handler run by the drain below may have logged into this ring
+        offset = pRing->writePos & (pRing->capacity - 1);
+        padding = pRing->capacity - offset < recordSize ? pRing->capacity - offset : 0;
+        if (pRing->capacity - (pRing->writePos - AtomicLoad(&pRing->readPos)) >= padding + recordSize)
+            break;
+
+        // we can't drain from inside a drain, so a handler logging into a full ring loses that message even when blocking
+        if (g_config.asyncOverflow == EDropMessage || t_holdsAsyncLock) {
+            AtomicAdd(&pRing->dropped, 1);
+            return nullptr;
+        }
+        // Blocking, so empty the rings ourselves rather than wait on the writer thread
+        AsyncLockAcquire();
+        DrainLogRings();
+        AsyncLockRelease();
+    }
+
+    i64 writePos = pRing->writePos;
+    if (padding > 0) {
+        if (padding >= (i64)sizeof(LogRecord))
+            ((LogRecord*)(pRing->pBuffer + offset))->length = LOG_RING_WRAP;
+        writePos += padding;
+        offset = 0;
+    }
+    LogRecord* pRecord = (LogRecord*)(pRing->pBuffer + offset);
+    pRecord->sequence = AtomicAdd(&g_logSequence, 1);
+    pRecord->length = length;
+    pRecord->level = (u16)level;
+    pRecord->binary = binary;
+    writeEnd = writePos + recordSize;
+    return pRecord;
+}
+
+// ***********************************************************************
+
+void PushBinaryMessage(Category* pCategory, LogLevel level, const char* text, va_list arguments) {
+    u64 timestamp = GetLogTimestamp();
+    u8 encoded[BINARY_LOG_MAX_ARGUMENTS];
+    i64 encodedLength = EncodeArguments(encoded, sizeof(encoded), text, arguments);
+
+    LogRing* pRing = t_pLogRing ? t_pLogRing : CreateLogRing();
+    StartLogWriter();
+
+    i64 writeEnd;
+    LogRecord* pRecord = BeginLogRecord(pRing, level, u32(sizeof(BinaryLogEntry) + encodedLength), true, writeEnd);
+    if (pRecord == nullptr)
+        return;
+    BinaryLogEntry* pEntry = (BinaryLogEntry*)(pRecord + 1);
+    pEntry->timestamp = timestamp;
+    pEntry->pFormat = text;
+    pEntry->pCategory = pCategory ? pCategory->name : nullptr;
+    memcpy(pEntry + 1, encoded, encodedLength);
+    AtomicStore(&pRing->writePos, writeEnd);
+}
+
+// ***********************************************************************
+
+void PushAsyncMessage(Category* pCategory, LogLevel level, const char* text, va_list arguments) {
+    if (g_config.binaryOutput) {
+        PushBinaryMessage(pCategory, level, text, arguments);
+        return;
+    }
+
+    ScratchScope(scratch, nullptr);
+    StringBuilder builder(scratch.pArena);
+    if (!g_config.silencePrefixes) AppendPrefix(builder, level, pCategory ? pCategory->name : nullptr);
+    builder.AppendFormatInternal(text, arguments);
+    builder.Append("\n");
+
+    LogRing* pRing = t_pLogRing ? t_pLogRing : CreateLogRing();
+    StartLogWriter();
+
+    // huge messages get cut down so they always fit
+    u32 length = (u32)builder.length;
+    if ((i64)Align(sizeof(LogRecord) + length, 8) > pRing->capacity / 2)
+        length = u32(pRing->capacity / 2 - sizeof(LogRecord));
+
+    i64 writeEnd;
+    LogRecord* pRecord = BeginLogRecord(pRing, level, length, false, writeEnd);
+    if (pRecord == nullptr)
+        return;
+    memcpy(pRecord + 1, builder.pData, length);
+    AtomicStore(&pRing->writePos, writeEnd);
+}
+
+// ***********************************************************************
+
+void LogMessage(Category* pCategory, LogLevel level, const char* text, va_list arguments) {
+    // before doing anything else, disabled messages should cost as little as possible
+    if (level > LOG_COMPILE_LEVEL || level > g_logLevel || (pCategory && level > pCategory->level))
+        return;
+
+    if (level <= ECrit) {
+        // we might be about to crash, get everything before this out first
+        if (g_config.asyncOutput || g_config.binaryOutput)
+            Flush();
+    } else if (g_config.asyncOutput || g_config.binaryOutput) {
+        PushAsyncMessage(pCategory, level, text, arguments);
+        return;
+    }
+
+    StringBuilder builder(g_pArenaFrame);
+    if (!g_config.silencePrefixes) AppendPrefix(builder, level, pCategory ? pCategory->name : nullptr);
+    builder.AppendFormatInternal(text, arguments);
+    builder.Append("\n");
+
+    String message = builder.CreateString(g_pArenaFrame);
+    PushLogMessage(level, message, 3); // leave out the Crit/Message call too
 }
 }
 
 // ***********************************************************************
 
+void Log::Flush() {
+    if (t_holdsAsyncLock)
+        return; // we're already inside a drain, whatever it's doing is the best we can get
+    AsyncLockAcquire();
+    DrainLogRings();
+    AsyncLockRelease();
+}
+
+// ***********************************************************************
+
+void Log::ThreadRingRelease() {
+    LogRing* pRing = t_pLogRing;
+    if (pRing == nullptr || t_holdsAsyncLock)
+        return;
+
+    // Nobody else writes to our ring, so once it's drained it stays empty. Drains only walk the list under the lock,
+    // and new rings are only pushed on the front, so holding it is enough to unlink
+    AsyncLockAcquire();
+    DrainLogRings();
+    LogRing* pHead = (LogRing*)AtomicLoad((volatile i64*)&g_pLogRings);
+    if (pHead != pRing || !AtomicCompareExchange((volatile i64*)&g_pLogRings, (i64)pRing, (i64)pRing->pNext)) {
+        LogRing* pPrev = (LogRing*)AtomicLoad((volatile i64*)&g_pLogRings);
+        while (pPrev->pNext != pRing)
+            pPrev = pPrev->pNext;
+        pPrev->pNext = pRing->pNext;
+    }
+    AsyncLockRelease();
+
+    t_pLogRing = nullptr;
+    VirtualRelease((u8*)pRing, sizeof(LogRing) + pRing->capacity);
+}
+
+// ***********************************************************************
+
+String Log::DecodeBinaryLog(String binaryLog, Arena* pArena, bool timestamps) {
+    ScratchScope(scratch, pArena);
+    StringBuilder builder(scratch.pArena);
+
+    const u8* pCursor = (const u8*)binaryLog.pData;
+    const u8* pEnd = pCursor + binaryLog.length;
+    if (binaryLog.length < 16 || memcmp(pCursor, BINARY_LOG_MAGIC, 8) != 0)
+        return String();
+    u64 frequency;
+    memcpy(&frequency, pCursor + 8, sizeof(u64));
+    pCursor += 16;
+
+    HashMap<u64, String> formats(scratch.pArena);
+    u64 firstTimestamp = 0;
+    bool first = true;
+    while (pCursor < pEnd) {
+        u8 type = *pCursor++;
+        if (type == BLE_FORMAT) {
+            u64 formatId;
+            u32 length;
+            if (pEnd - pCursor < 12)
+                break;
+            memcpy(&formatId, pCursor, sizeof(u64));
+            memcpy(&length, pCursor + 8, sizeof(u32));
+            pCursor += 12;
+            if (pEnd - pCursor < length)
+                break;
+            // null terminated copy, the decoder walks it like a C string
+            String format = AllocString(length + 1, scratch.pArena);
+            memcpy(format.pData, pCursor, length);
+            format.pData[length] = 0;
+            format.length = length;
+            formats.Add(formatId, format);
+            pCursor += length;
+        } else if (type == BLE_MESSAGE) {
+            u8 level;
+            u64 timestamp;
+            u64 formatId;
+            u64 categoryId;
+            u32 argumentsLength;
+            if (pEnd - pCursor < 29)
+                break;
+            level = pCursor[0];
+            memcpy(&timestamp, pCursor + 1, sizeof(u64));
+            memcpy(&formatId, pCursor + 9, sizeof(u64));
+            memcpy(&categoryId, pCursor + 17, sizeof(u64));
+            memcpy(&argumentsLength, pCursor + 25, sizeof(u32));
+            pCursor += 29;
+            if (pEnd - pCursor < argumentsLength)
+                break;
+
+            if (first) {
+                firstTimestamp = timestamp;
+                first = false;
+            }
+            if (timestamps)
+                builder.AppendFormat("[%12.6f] ", f64(i64(timestamp - firstTimestamp)) / f64(frequency));
+            String* pCategory = categoryId ? formats.Get(categoryId) : nullptr;
+            AppendPrefix(builder, LogLevel(level), pCategory ? pCategory->pData : nullptr);
+
+            String* pFormat = formats.Get(formatId);
+            if (pFormat)
+                DecodeMessage(builder, pFormat->pData, pCursor, argumentsLength);
+            else
+                builder.Append("<missing format string>");
+            builder.Append("\n");
+            pCursor += argumentsLength;
+        } else if (type == BLE_DROPPED) {
+            i64 dropped;
+            if (pEnd - pCursor < 8)
+                break;
+            memcpy(&dropped, pCursor, sizeof(i64));
+            pCursor += 8;
+            builder.AppendFormat("[LOG] %lli messages dropped, a ring buffer was full\n", dropped);
+        } else {
+            break; // corrupt or truncated, keep what we have
+        }
+    }
+    return builder.CreateString(pArena);
+}
+
+// ***********************************************************************
+
 void Log::SetConfig(LogConfig _config) {
+    // anything already buffered goes out under the old config
+    AsyncLockAcquire();
+    DrainLogRings();
     g_config = _config;
+    AsyncLockRelease();
 }
 
 // ***********************************************************************
@@ -66,68 +1033,55 @@ void Log::SetLogLevel(LogLevel level) {
 
 // ***********************************************************************
 
-void Log::Crit(const char* text, ...) {
-    StringBuilder builder(g_pArenaFrame);
-    if (!g_config.silencePrefixes) builder.Append("[CRITICAL] ");
+void Log::Message(Category& category, LogLevel level, const char* text, ...) {
     va_list arguments;
     va_start(arguments, text);
-    builder.AppendFormatInternal(text, arguments);
+    LogMessage(&category, level, text, arguments);
     va_end(arguments);
-    builder.Append("\n");
+}
 
-    String message = builder.CreateString(g_pArenaFrame);
-    PushLogMessage(LogLevel::ECrit, message);
+// ***********************************************************************
+
+void Log::Crit(const char* text, ...) {
+    va_list arguments;
+    va_start(arguments, text);
+    LogMessage(nullptr, LogLevel::ECrit, text, arguments);
+    va_end(arguments);
 }
 
 // ***********************************************************************
 
 void Log::Warn(const char* text, ...) {
-    StringBuilder builder(g_pArenaFrame);
-	if (!g_config.silencePrefixes) builder.Append("[WARNING] ");
     va_list arguments;
     va_start(arguments, text);
-    builder.AppendFormatInternal(text, arguments);
+    LogMessage(nullptr, LogLevel::EWarn, text, arguments);
     va_end(arguments);
-    builder.Append("\n");
-
-    String message = builder.CreateString(g_pArenaFrame);
-    PushLogMessage(LogLevel::EWarn, message);
 }
 
 // ***********************************************************************
 
 void Log::Info(const char* text, ...) {
-    StringBuilder builder(g_pArenaFrame);
-	if (!g_config.silencePrefixes) builder.Append("[INFO] ");
     va_list arguments;
     va_start(arguments, text);
-    builder.AppendFormatInternal(text, arguments);
+    LogMessage(nullptr, LogLevel::EInfo, text, arguments);
     va_end(arguments);
-    builder.Append("\n");
-
-    String message = builder.CreateString(g_pArenaFrame);
-    PushLogMessage(LogLevel::EInfo, message);
 }
 
 // ***********************************************************************
 
 void Log::Debug(const char* text, ...) {
-    StringBuilder builder(g_pArenaFrame);
-	if (!g_config.silencePrefixes) builder.Append("[DEBUG] ");
     va_list arguments;
     va_start(arguments, text);
-    builder.AppendFormatInternal(text, arguments);
+    LogMessage(nullptr, LogLevel::EDebug, text, arguments);
     va_end(arguments);
-    builder.Append("\n");
-
-    String message = builder.CreateString(g_pArenaFrame);
-    PushLogMessage(LogLevel::EDebug, message);
 }
 
 // ***********************************************************************
 
 void Log::_Assertion(bool expression, const char* message) {
     if (!expression) {
+		if (g_config.asyncOutput || g_config.binaryOutput)
+			Flush();
 		StringBuilder builder(g_pArenaFrame);
 		if (!g_config.silencePrefixes) builder.Append("[ASSERT FAIL] ");
         builder.Append(message);
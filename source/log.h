@@ -13,19 +13,64 @@ enum LogLevel {
     EDebug
 };
 
+// What async logging does when a thread's ring buffer is full
+enum OverflowPolicy {
+    EDropMessage, // drop it, the drop is counted and reported in the log
+    EBlock        // wait until there's room. A custom handler logging into a full ring still drops, it's running inside the wait
+};
+
 struct LogConfig {
     bool winOutput { true };
     bool consoleOutput { true };
     bool fileOutput { true };
     bool critCrashes { true };
 	bool silencePrefixes { false };
+	bool symbolizeCritTraces { true }; // false prints raw module+offset frames instead, for symbolizing offline
+
+	// Async output, messages are formatted on the calling thread and written by a background thread in batches.
+	// Crits and asserts are always written immediately (after flushing whatever came before them)
+	bool asyncOutput { false };
+	u32 asyncFlushIntervalMs { 50 };
+	i64 asyncBufferSize { 64 * 1024 }; // per thread, rounded up to a power of two
+	OverflowPolicy asyncOverflow { EDropMessage };
+
+	// Binary output, implies async. Info/Warn/Debug calls don't format at all, they record the format string pointer,
+	// a timestamp and the raw arguments, and the file output goes to application.binlog for DecodeBinaryLog to
+	// render later. Format strings must live for the whole program (string literals are fine)
+	bool binaryOutput { false };
 
     void (*customHandler1)(LogLevel, String) = nullptr;
     void (*customHandler2)(LogLevel, String) = nullptr;
 };
 
+// Categories
+// ---------------------
+// A named subsystem with its own level, on top of the global one. Define one in a cpp with
+// LOG_DEFINE_CATEGORY(Render, Log::EInfo), declare it in headers with LOG_DECLARE_CATEGORY(Render), and
+// log with LogInfo(Render, "format", ...). Change its level at runtime with LOG_CATEGORY(Render).level.
+// The Log* macros check the level inline before evaluating any arguments, so disabled calls cost a compare,
+// and anything above LOG_COMPILE_LEVEL isn't compiled at all
+
+struct Category {
+    const char* name;
+    LogLevel level; // messages less important than this are skipped
+};
+
+extern LogLevel g_logLevel;
+
+inline bool IsEnabled(const Category& category, LogLevel level) {
+    return level <= category.level && level <= g_logLevel;
+}
+
+void Message(Category& category, LogLevel level, const char* text, ...);
+
 void SetConfig(LogConfig config);
 void SetLogLevel(LogLevel level);
+void Flush(); // write out everything async logging has buffered so far
+void ThreadRingRelease(); // call before a thread exits if it logged with async or binary output on
+
+// Renders a binary log file's contents back to the text the normal log would have had
+String DecodeBinaryLog(String binaryLog, Arena* pArena, bool timestamps = true);
 
 void Crit(const char* text, ...);
 void Warn(const char* text, ...);
@@ -35,6 +80,34 @@ void Debug(const char* text, ...);
 void _Assertion(bool expression, const char* message);
 }
 
+#define LOG_CATEGORY(category) g_logCategory##category
+#define LOG_DEFINE_CATEGORY(category, level) Log::Category LOG_CATEGORY(category) { #category, level }
+#define LOG_DECLARE_CATEGORY(category) extern Log::Category LOG_CATEGORY(category)
+
+// Calls less important than this compile to nothing, define it before including common_lib to change it
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 4 // Log::EDebug
+#endif
+
+#define LOG_CATEGORY_MESSAGE(category, level, ...) do { if (Log::IsEnabled(LOG_CATEGORY(category), level)) Log::Message(LOG_CATEGORY(category), level, __VA_ARGS__); } while (0)
+
+#define LogCrit(category, ...) LOG_CATEGORY_MESSAGE(category, Log::ECrit, __VA_ARGS__)
+#if LOG_COMPILE_LEVEL >= 2
+#define LogWarn(category, ...) LOG_CATEGORY_MESSAGE(category, Log::EWarn, __VA_ARGS__)
+#else
+#define LogWarn(category, ...) do {} while (0)
+#endif
+#if LOG_COMPILE_LEVEL >= 3
+#define LogInfo(category, ...) LOG_CATEGORY_MESSAGE(category, Log::EInfo, __VA_ARGS__)
+#else
+#define LogInfo(category, ...) do {} while (0)
+#endif
+#if LOG_COMPILE_LEVEL >= 4
+#define LogDebug(category, ...) LOG_CATEGORY_MESSAGE(category, Log::EDebug, __VA_ARGS__)
+#else
+#define LogDebug(category, ...) do {} while (0)
+#endif
+
 #ifdef _DEBUG
 #define Assert(expression) Log::_Assertion((expression), (#expression))
 #define AssertMsg(expression, msg) Log::_Assertion((expression), msg)
@@ -42,3 +115,10 @@ void _Assertion(bool expression, const char* message);
 #define Assert(expression)
 #define AssertMsg(expression, msg)
 #endif
+
+// Stops in the debugger, or takes the program down when there isn't one attached
+#ifdef _WIN32
+#define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() __builtin_trap()
+#endif
@@ -635,7 +635,7 @@ inline void Matrix<T>::SetTranslation(Vec3<T> translation) {
 // ***********************************************************************
 
 template<typename T>
-inline static Matrix<T> Matrix<T>::MakeTRS(Vec3<T> translation, Vec3<T> eulerAngles, Vec3<T> scale) {
+inline Matrix<T> Matrix<T>::MakeTRS(Vec3<T> translation, Vec3<T> eulerAngles, Vec3<T> scale) {
     // This is a body 3-2-1 (z, then y, then x) rotation
     const T cx = cos(eulerAngles.x);
     const T sx = sin(eulerAngles.x);
@@ -670,7 +670,7 @@ inline static Matrix<T> Matrix<T>::MakeTRS(Vec3<T> translation, Vec3<T> eulerAng
 // ***********************************************************************
 
 template<typename T>
-inline static Matrix<T> Matrix<T>::MakeTQS(Vec3<T> translation, Quat<T> rot, Vec3<T> scale) {
+inline Matrix<T> Matrix<T>::MakeTQS(Vec3<T> translation, Quat<T> rot, Vec3<T> scale) {
     Matrix<T> mat;
     mat.m[0][0] = (1.0f - 2.0f * rot.y * rot.y - 2.0f * rot.z * rot.z) * scale.x;
     mat.m[0][1] = (2.0f * rot.x * rot.y + 2.0f * rot.z * rot.w) * scale.x;
@@ -1,8 +1,32 @@
 // Copyright 2020-2022 David Colson. All rights reserved.
 
+#if defined(__SANITIZE_ADDRESS__)
+#define ARENA_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ARENA_ASAN
+#endif
+#endif
+
+#ifdef ARENA_ASAN
+#include <sanitizer/asan_interface.h>
+#define ArenaPoison(pAddress, size) ASAN_POISON_MEMORY_REGION(pAddress, size)
+#define ArenaUnpoison(pAddress, size) ASAN_UNPOISON_MEMORY_REGION(pAddress, size)
+#define ARENA_REDZONE ARENA_ASAN_REDZONE
+#else
+#define ArenaPoison(pAddress, size)
+#define ArenaUnpoison(pAddress, size)
+#define ARENA_REDZONE 0
+#endif
+
 Arena* g_pArenaFrame = nullptr;
 Arena* g_pArenaPermenant = nullptr;
 
+thread_local Arena* g_pScratchArenas[2] = { nullptr, nullptr };
+
+static Arena* g_pArenaList = nullptr;
+static SpinLock g_arenaListLock;
+
 // ***********************************************************************
 
 u64 Align(u64 toAlign, u64 alignment) {
@@ -18,33 +42,50 @@ u8* AlignPtr(u8* toAlign, u64 alignment) {
 
 // ***********************************************************************
 
-Arena* ArenaCreate(i64 defaultReserve, bool noTrack) {
-	SYSTEM_INFO sysInfo;
-    GetSystemInfo(&sysInfo);
+Arena* ArenaCreate(i64 defaultReserve, bool noTrack, u32 flags) {
+	// with huge pages we commit in huge page steps, otherwise the kernel can't back the range with them
+	i64 pageSize = (flags & (AF_HUGE_PAGES | AF_HUGETLB)) ? VirtualHugePageSize() : VirtualPageSize();
 
-    i64 reserveSize = Align(defaultReserve, sysInfo.dwPageSize);
-    u8* pMemory = (u8*)VirtualAlloc(nullptr, reserveSize, MEM_RESERVE, PAGE_READWRITE);
+    i64 reserveSize = Align(defaultReserve, pageSize);
+    u8* pMemory = VirtualReserve(reserveSize, flags);
+    Assert(pMemory != nullptr);
 
 	// commit the first page for the header
-    u64 firstPageSize = Align(sizeof(Arena), sysInfo.dwPageSize);
-    VirtualAlloc(pMemory, firstPageSize, MEM_COMMIT, PAGE_READWRITE);
-
-    Assert(pMemory != nullptr);
+    u64 firstPageSize = Align(sizeof(Arena), pageSize);
+    VirtualCommit(pMemory, firstPageSize);
 
 #ifdef MEMORY_TRACKING
 	if (!noTrack)
 		CheckMalloc(pMemory, firstPageSize);
 #endif
 
+	AssertMsg(!((flags & AF_CHAINED) && (flags & AF_CONCURRENT)), "Chained arenas can't be concurrent");
+	AssertMsg(!((flags & AF_GUARD_PAGES) && (flags & AF_CONCURRENT)), "Guard page arenas can't be concurrent");
 	Arena* pArena = (Arena*)pMemory; 
 
-	pArena->pageSize = sysInfo.dwPageSize;
+	pArena->pageSize = pageSize;
 	pArena->reserveSize = reserveSize;
-	pArena->pMemoryBase = pMemory + sizeof(Arena);
+	pArena->pMemoryBase = AlignPtr(pMemory + sizeof(Arena), CONCURRENT_ARENA_ALIGN);
     pArena->pFirstUncommittedPage = pMemory + firstPageSize;
     pArena->pAddressLimit = pMemory + pArena->reserveSize;
+	if (flags & AF_GUARD_PAGES) {
+		// keep allocations off the header page and leave a gap after it, so everything handed out can be decommitted
+		pArena->pMemoryBase = pMemory + firstPageSize + pageSize;
+		pArena->pFirstUncommittedPage = pArena->pMemoryBase;
+	}
     pArena->pCurrentHead = pArena->pMemoryBase;
+	pArena->pZeroedFrom = pArena->pMemoryBase;
     pArena->noTrack = noTrack;
+	pArena->flags = flags;
+	pArena->name = "Unnamed Arena";
+	ArenaPoison(pArena->pMemoryBase, pArena->pFirstUncommittedPage - pArena->pMemoryBase);
+
+	SpinLockAcquire(g_arenaListLock);
+	pArena->pNextArena = g_pArenaList;
+	if (g_pArenaList)
+		g_pArenaList->pPrevArena = pArena;
+	g_pArenaList = pArena;
+	SpinLockRelease(g_arenaListLock);
 	return pArena;
 }
 
@@ -56,24 +97,222 @@ void ArenaReset(Arena* pArena) {
 	if (pArena->pMemoryBase == nullptr)
         return;
 
+	i64 used = ArenaUsedBytes(pArena);
+	ArenaReleaseChunks(pArena);
+
 #ifdef STAMP_RESET_ARENAS
-	memset(pArena->pMemoryBase, 0xcc, pArena->pCurrentHead - pArena->pMemoryBase);
+	// guard page arenas decommit instead, and stamping would fault on their guard pages
+	if (!(pArena->flags & AF_GUARD_PAGES))
+		memset(pArena->pMemoryBase, 0xcc, pArena->pCurrentHead - pArena->pMemoryBase);
 #endif
+	ArenaPoison(pArena->pMemoryBase, pArena->pCurrentHead - pArena->pMemoryBase);
+	if (pArena->flags & AF_GUARD_PAGES)
+		ArenaShrinkCommitted(pArena, pArena->pMemoryBase);
+
+	pArena->stats.resetCount++;
+	if (used > pArena->stats.peakUsed)
+		pArena->stats.peakUsed = used;
+
+	if (pArena->retainWindow > 0) {
+		// Record this cycle's usage, and keep only what the busiest of the recent cycles needed
+		i64 cycle = pArena->retainCycles++;
+		pArena->highWaterHistory[cycle % pArena->retainWindow] = used;
 
+		i64 retain = pArena->retainMinimum;
+		i64 historySize = pArena->retainCycles < pArena->retainWindow ? pArena->retainCycles : pArena->retainWindow;
+		for (i64 i = 0; i < historySize; i++) {
+			if (pArena->highWaterHistory[i] > retain)
+				retain = pArena->highWaterHistory[i];
+		}
+		ArenaShrinkCommitted(pArena, pArena->pMemoryBase + retain);
+	}
+
+	ArenaReleaseLargeBlocks(pArena);
     pArena->pCurrentHead = pArena->pMemoryBase;
 }
 
 // ***********************************************************************
 
+void ArenaSetRetention(Arena* pArena, i64 minRetainedBytes, i32 window) {
+	Assert(pArena);
+	Assert(window >= 0 && window <= ARENA_RETENTION_WINDOW);
+
+	pArena->retainMinimum = minRetainedBytes;
+	pArena->retainWindow = window;
+	pArena->retainCycles = 0;
+	memset(pArena->highWaterHistory, 0, sizeof(pArena->highWaterHistory));
+}
+
+// ***********************************************************************
+
+void ArenaSetName(Arena* pArena, const char* name) {
+	Assert(pArena);
+	pArena->name = name;
+}
+
+// ***********************************************************************
+
+i64 ArenaUsedBytes(Arena* pArena) {
+	return pArena->chainedBytes + (pArena->pCurrentHead - pArena->pMemoryBase);
+}
+
+// ***********************************************************************
+
+i64 ArenaCommittedBytes(Arena* pArena) {
+	i64 committed = pArena->pFirstUncommittedPage - (pArena->pChunks ? (u8*)pArena->pChunks : (u8*)pArena) - pArena->guardBytes;
+	for (ArenaChunk* pChunk = pArena->pChunks; pChunk; pChunk = pChunk->pPrev) {
+		committed += pChunk->pSavedFirstUncommittedPage - (pChunk->pPrev ? (u8*)pChunk->pPrev : (u8*)pArena) - pChunk->savedGuardBytes;
+	}
+	for (ArenaLargeBlock* pBlock = pArena->pLargeBlocks; pBlock; pBlock = pBlock->pNext) {
+		committed += pBlock->committedSize;
+	}
+	return committed;
+}
+
+// ***********************************************************************
+
+ArenaStats ArenaGetStats(Arena* pArena) {
+	Assert(pArena);
+
+	i64 used = ArenaUsedBytes(pArena);
+	if (used > pArena->stats.peakUsed)
+		pArena->stats.peakUsed = used;
+	return pArena->stats;
+}
+
+// ***********************************************************************
+
+void ArenaForEach(ArenaVisitor visitor, void* pUserData) {
+	SpinLockAcquire(g_arenaListLock);
+	for (Arena* pArena = g_pArenaList; pArena; pArena = pArena->pNextArena) {
+		visitor(pArena, pUserData);
+	}
+	SpinLockRelease(g_arenaListLock);
+}
+
+// ***********************************************************************
+
+void ReportArenaUsage() {
+	// Grab scratch before walking the list, creating a scratch arena needs the list lock
+	ScratchScope(scratch, nullptr);
+	StringBuilder builder(scratch.pArena);
+	builder.Append("Live arenas:\n");
+
+	ArenaForEach([](Arena* pArena, void* pUserData) {
+		StringBuilder& builder = *(StringBuilder*)pUserData;
+		ArenaStats stats = ArenaGetStats(pArena);
+		builder.AppendFormat(" %-24s used %12lli  peak %12lli  committed %12lli  reserved %12lli  resets %8lli  commits %8lli  decommits %8lli  abandoned %12lli",
+			pArena->name, ArenaUsedBytes(pArena), stats.peakUsed, ArenaCommittedBytes(pArena), pArena->reserveSize,
+			stats.resetCount, stats.commitCount, stats.decommitCount, stats.bytesAbandoned);
+#ifdef ARENA_STATS
+		builder.AppendFormat("  allocs %10lli  requested %12lli  align waste %10lli  reallocs %8lli  realloc copies %8lli",
+			stats.allocationCount, stats.bytesRequested, stats.bytesAlignmentWaste, stats.reallocCount, stats.reallocCopies);
+#endif
+		builder.Append("\n");
+	}, &builder);
+
+	Log::Info("%s", builder.CreateString(scratch.pArena).pData);
+}
+
+// ***********************************************************************
+
+ArenaTemp ArenaTempBegin(Arena* pArena) {
+	Assert(pArena);
+
+	ArenaTemp temp;
+	temp.pArena = pArena;
+	temp.pSavedHead = pArena->pCurrentHead;
+	temp.savedLargeBlockSerial = pArena->nextLargeBlockSerial;
+	temp.savedGuardBytes = pArena->guardBytes;
+	return temp;
+}
+
+// ***********************************************************************
+
+void ArenaTempEnd(ArenaTemp temp) {
+	Assert(temp.pArena);
+
+	// before any chunks the region grew into are released, they count towards the peak too
+	i64 used = ArenaUsedBytes(temp.pArena);
+	if (used > temp.pArena->stats.peakUsed)
+		temp.pArena->stats.peakUsed = used;
+
+	if (temp.pArena->pChunks)
+		ArenaReleaseChunks(temp.pArena, temp.pSavedHead);
+	AssertMsg(temp.pSavedHead <= temp.pArena->pCurrentHead, "Arena head is behind a temp region, was the arena reset or temps ended out of order?");
+
+#ifdef STAMP_RESET_ARENAS
+	if (!(temp.pArena->flags & AF_GUARD_PAGES))
+		memset(temp.pSavedHead, 0xcc, temp.pArena->pCurrentHead - temp.pSavedHead);
+#endif
+
+	ArenaPoison(temp.pSavedHead, temp.pArena->pCurrentHead - temp.pSavedHead);
+	ArenaReleaseLargeBlocks(temp.pArena, temp.savedLargeBlockSerial);
+	if (temp.pArena->flags & AF_GUARD_PAGES) {
+		// the saved head sits just past the guard page of the allocation before it, committed memory ended there
+		u8* pCommitEnd = temp.pSavedHead > temp.pArena->pMemoryBase ? temp.pSavedHead - temp.pArena->pageSize : temp.pSavedHead;
+		ArenaShrinkCommitted(temp.pArena, pCommitEnd, temp.savedGuardBytes);
+	}
+
+	temp.pArena->pCurrentHead = temp.pSavedHead;
+}
+
+// ***********************************************************************
+
+ArenaTemp ScratchBegin(Arena* pConflict) {
+	// Two is enough, one for the caller's output and the other for our own temporaries
+	for (int i = 0; i < 2; i++) {
+		if (g_pScratchArenas[i] == nullptr) {
+			g_pScratchArenas[i] = ArenaCreate(DEFAULT_RESERVE, true);
+			ArenaSetName(g_pScratchArenas[i], "Scratch");
+		}
+
+		if (g_pScratchArenas[i] != pConflict)
+			return ArenaTempBegin(g_pScratchArenas[i]);
+	}
+	return ArenaTemp {};
+}
+
+// ***********************************************************************
+
+void ScratchEnd(ArenaTemp temp) {
+	ArenaTempEnd(temp);
+}
+
+// ***********************************************************************
+
+void ScratchArenasRelease() {
+	for (int i = 0; i < 2; i++) {
+		if (g_pScratchArenas[i]) {
+			ArenaFinished(g_pScratchArenas[i]);
+			g_pScratchArenas[i] = nullptr;
+		}
+	}
+}
+
+// ***********************************************************************
+
 void ArenaFinished(Arena* pArena) {
 	Assert(pArena);
 
 	if (pArena->pMemoryBase != nullptr) {
+		SpinLockAcquire(g_arenaListLock);
+		if (pArena->pPrevArena)
+			pArena->pPrevArena->pNextArena = pArena->pNextArena;
+		else
+			g_pArenaList = pArena->pNextArena;
+		if (pArena->pNextArena)
+			pArena->pNextArena->pPrevArena = pArena->pPrevArena;
+		SpinLockRelease(g_arenaListLock);
+
+		ArenaReleaseLargeBlocks(pArena);
+		ArenaReleaseChunks(pArena);
+		ArenaUnpoison(pArena, pArena->pFirstUncommittedPage - (u8*)pArena);
 #ifdef MEMORY_TRACKING
 	if (!pArena->noTrack)
         CheckFree(pArena);
 #endif
-        VirtualFree(pArena, 0, MEM_RELEASE);
+        VirtualRelease((u8*)pArena, pArena->reserveSize);
     }
 }
 
@@ -82,48 +321,375 @@ void ArenaFinished(Arena* pArena) {
 void ArenaExpandCommitted(Arena* pArena, u8* pDesiredEnd) {
 	Assert(pArena);
 
-	i64 currentSpace = pArena->pFirstUncommittedPage - pArena->pMemoryBase;
+	u8* pRegionStart = pArena->pChunks ? (u8*)pArena->pChunks : (u8*)pArena; // what the tracker knows this region as
+	i64 currentSpace = pArena->pFirstUncommittedPage - pRegionStart - pArena->guardBytes;
     i64 requiredSpace = pDesiredEnd - pArena->pFirstUncommittedPage;
     Assert(requiredSpace > 0);
-	Assert(requiredSpace < pArena->reserveSize); // block runaway memory leaks
+	Assert(requiredSpace < pArena->pAddressLimit - pArena->pMemoryBase); // block runaway memory leaks
 
     u64 size = Align(requiredSpace, pArena->pageSize);
-    VirtualAlloc(pArena->pFirstUncommittedPage, size, MEM_COMMIT, PAGE_READWRITE);
+    bool committed = VirtualCommit(pArena->pFirstUncommittedPage, size);
+	AssertMsg(committed, "Failed to commit arena memory");
+#ifdef MEMORY_TRACKING
+	if (!pArena->noTrack)
+		CheckRealloc(pRegionStart, pRegionStart, currentSpace + size, currentSpace);
+#endif
+	ArenaPoison(pArena->pFirstUncommittedPage, size);
+
+	// atomic so concurrent allocators only ever see this move once the pages are ready
+	AtomicStore((volatile i64*)&pArena->pFirstUncommittedPage, i64(pArena->pFirstUncommittedPage + size));
+	pArena->stats.commitCount++;
+}
+
+// ***********************************************************************
+
+void ArenaCommitConcurrent(Arena* pArena, u8* pDesiredEnd) {
+	// Fast path only ever reads the committed end, growing it is serialised here
+	if (pDesiredEnd <= (u8*)AtomicLoad((volatile i64*)&pArena->pFirstUncommittedPage))
+		return;
+
+	Assert(pDesiredEnd < pArena->pAddressLimit);
+	SpinLockAcquire(pArena->commitLock);
+	if (pDesiredEnd > pArena->pFirstUncommittedPage) // another thread may have committed it while we waited
+		ArenaExpandCommitted(pArena, pDesiredEnd);
+	SpinLockRelease(pArena->commitLock);
+}
+
+// ***********************************************************************
+
+void* ArenaAllocConcurrent(Arena* pArena, i64 size, i64 align, bool uninitialized) {
+	// The head is always CONCURRENT_ARENA_ALIGN aligned, so we only pad for alignments bigger than that,
+	// which means we can claim our block with a single fetch add, no retry loop
+	i64 claimSize = Align(size, CONCURRENT_ARENA_ALIGN);
+	if (align > CONCURRENT_ARENA_ALIGN)
+		claimSize += align - CONCURRENT_ARENA_ALIGN;
+
+	u8* pStart = (u8*)AtomicAdd((volatile i64*)&pArena->pCurrentHead, claimSize);
+	u8* pMemory = AlignPtr(pStart, align);
+	ArenaCommitConcurrent(pArena, pStart + claimSize);
+
+	ArenaUnpoison(pMemory, size);
+
+#ifdef ARENA_STATS
+	AtomicAdd(&pArena->stats.allocationCount, 1);
+	AtomicAdd(&pArena->stats.bytesRequested, size);
+	AtomicAdd(&pArena->stats.bytesAlignmentWaste, claimSize - size);
+#endif
+
+	if (!uninitialized)
+		memset(pMemory, 0, size);
+	return pMemory;
+}
+
+// ***********************************************************************
+
+void ArenaShrinkCommitted(Arena* pArena, u8* pDesiredEnd, i64 guardBytesKept) {
+	Assert(pArena);
+
+	// The page holding the arena header is never given back
+	u8* pNewEnd = AlignPtr(pDesiredEnd < pArena->pMemoryBase ? pArena->pMemoryBase : pDesiredEnd, pArena->pageSize);
+	if (pNewEnd >= pArena->pFirstUncommittedPage)
+		return;
+
+	u8* pRegionStart = pArena->pChunks ? (u8*)pArena->pChunks : (u8*)pArena;
+	i64 currentSpace = pArena->pFirstUncommittedPage - pRegionStart - pArena->guardBytes;
+	i64 size = pArena->pFirstUncommittedPage - pNewEnd;
+	i64 decommitted = size - (pArena->guardBytes - guardBytesKept); // guard pages in the range were never committed
+	VirtualDecommit(pNewEnd, size);
+	ArenaUnpoison(pNewEnd, size); // only committed memory is ever poisoned, so ArenaFinished knows what to clean up
 #ifdef MEMORY_TRACKING
 	if (!pArena->noTrack)
-		CheckRealloc(pArena->pMemoryBase, pArena->pMemoryBase, currentSpace + size, currentSpace);
+		CheckRealloc(pRegionStart, pRegionStart, currentSpace - decommitted, currentSpace);
 #endif
-    pArena->pFirstUncommittedPage += size;
+	pArena->pFirstUncommittedPage = pNewEnd;
+	pArena->guardBytes = guardBytesKept;
+	if (pArena->pZeroedFrom > pNewEnd) // decommitted pages come back zeroed
+		pArena->pZeroedFrom = pNewEnd;
+	pArena->stats.decommitCount++;
+	pArena->stats.bytesDecommitted += decommitted;
 }
 
 
+// ***********************************************************************
+
+void ArenaZeroAndClaim(Arena* pArena, u8* pStart, u8* pEnd, bool uninitialized) {
+	ArenaUnpoison(pStart, pEnd - pStart);
+
+	// Only memory below the watermark can be dirty, fresh pages above it are already zero from the OS
+	u8* pZeroedFrom = pArena->pZeroedFrom;
+	if (!uninitialized && pStart < pZeroedFrom)
+		memset(pStart, 0, (pEnd < pZeroedFrom ? pEnd : pZeroedFrom) - pStart);
+	if (pEnd > pZeroedFrom)
+		pArena->pZeroedFrom = pEnd;
+}
+
+// ***********************************************************************
+
+void ArenaAddChunk(Arena* pArena, i64 size, i64 align) {
+	// New chunks match the arena's own reservation, unless this one allocation needs more
+	i64 required = Align(sizeof(ArenaChunk), CONCURRENT_ARENA_ALIGN) + size + align;
+	i64 reserveSize = Align(required > pArena->reserveSize ? required : pArena->reserveSize, pArena->pageSize);
+	u8* pMemory = VirtualReserve(reserveSize, pArena->flags);
+	AssertMsg(pMemory != nullptr, "Failed to reserve a new arena chunk");
+
+	u64 firstPageSize = Align(sizeof(ArenaChunk), pArena->pageSize);
+	VirtualCommit(pMemory, firstPageSize);
+#ifdef MEMORY_TRACKING
+	if (!pArena->noTrack)
+		CheckMalloc(pMemory, firstPageSize);
+#endif
+
+	ArenaChunk* pChunk = (ArenaChunk*)pMemory;
+	pChunk->pPrev = pArena->pChunks;
+	pChunk->reserveSize = reserveSize;
+	pChunk->pSavedBase = pArena->pMemoryBase;
+	pChunk->pSavedHead = pArena->pCurrentHead;
+	pChunk->pSavedFirstUncommittedPage = pArena->pFirstUncommittedPage;
+	pChunk->pSavedAddressLimit = pArena->pAddressLimit;
+	pChunk->pSavedZeroedFrom = pArena->pZeroedFrom;
+	pChunk->savedGuardBytes = pArena->guardBytes;
+	pArena->pChunks = pChunk;
+
+	// the tail of the old region is left unused, it only counts towards used bytes up to where the head got to
+	pArena->chainedBytes += pArena->pCurrentHead - pArena->pMemoryBase;
+	pArena->pMemoryBase = AlignPtr(pMemory + sizeof(ArenaChunk), CONCURRENT_ARENA_ALIGN);
+	pArena->pCurrentHead = pArena->pMemoryBase;
+	pArena->pFirstUncommittedPage = pMemory + firstPageSize;
+	pArena->pAddressLimit = pMemory + reserveSize;
+	pArena->pZeroedFrom = pArena->pMemoryBase;
+	pArena->guardBytes = 0;
+	ArenaPoison(pArena->pMemoryBase, pArena->pFirstUncommittedPage - pArena->pMemoryBase);
+}
+
+// ***********************************************************************
+
+void ArenaReleaseChunks(Arena* pArena, u8* pKeepHead) {
+	while (ArenaChunk* pChunk = pArena->pChunks) {
+		if (pKeepHead && pKeepHead >= pArena->pMemoryBase && pKeepHead <= pArena->pAddressLimit)
+			return;
+
+		u8* pCurrentCommitEnd = pArena->pFirstUncommittedPage;
+
+		pArena->pMemoryBase = pChunk->pSavedBase;
+		pArena->pCurrentHead = pChunk->pSavedHead;
+		pArena->pFirstUncommittedPage = pChunk->pSavedFirstUncommittedPage;
+		pArena->pAddressLimit = pChunk->pSavedAddressLimit;
+		pArena->pZeroedFrom = pChunk->pSavedZeroedFrom;
+		pArena->guardBytes = pChunk->savedGuardBytes;
+		pArena->chainedBytes -= pChunk->pSavedHead - pChunk->pSavedBase;
+		pArena->pChunks = pChunk->pPrev;
+		ArenaUnpoison(pChunk, pCurrentCommitEnd - (u8*)pChunk);
+
+#ifdef MEMORY_TRACKING
+		if (!pArena->noTrack)
+			CheckFree(pChunk);
+#endif
+		VirtualRelease((u8*)pChunk, pChunk->reserveSize);
+	}
+}
+
+// ***********************************************************************
+
+void* ArenaAllocGuarded(Arena* pArena, i64 size, i64 align, bool uninitialized) {
+	// Push the allocation as close to the end of its pages as alignment allows, and skip over the next page
+	// without committing it, so overrunning the block faults straight away
+	i64 pageSize = pArena->pageSize;
+	u8* pPagesEnd = AlignPtr(pArena->pCurrentHead + size + align, pageSize);
+	if (pPagesEnd + pageSize > pArena->pAddressLimit && (pArena->flags & AF_CHAINED)) {
+		ArenaAddChunk(pArena, size + align + 2 * pageSize, pageSize);
+		pPagesEnd = AlignPtr(pArena->pCurrentHead + size + align, pageSize);
+	}
+	Assert(pPagesEnd + pageSize <= pArena->pAddressLimit);
+
+	u8* pMemory = (u8*)(u64(pPagesEnd - size) & ~(align - 1));
+	u8* pPagesStart = (u8*)(u64(pMemory) & ~(pageSize - 1));
+	if (pPagesStart > pArena->pFirstUncommittedPage) {
+		// the last allocation's guard page (and any pages alignment skipped) stay uncommitted
+		pArena->guardBytes += pPagesStart - pArena->pFirstUncommittedPage;
+		pArena->pFirstUncommittedPage = pPagesStart;
+	}
+	if (pPagesEnd > pArena->pFirstUncommittedPage)
+		ArenaExpandCommitted(pArena, pPagesEnd);
+
+#ifdef ARENA_STATS
+	pArena->stats.allocationCount++;
+	pArena->stats.bytesRequested += size;
+	pArena->stats.bytesAlignmentWaste += pMemory - pArena->pCurrentHead;
+#endif
+
+	pArena->pCurrentHead = pPagesEnd + pageSize;
+	ArenaZeroAndClaim(pArena, pMemory, pMemory + size, uninitialized);
+	return pMemory;
+}
+
 // ***********************************************************************
 
 void* ArenaAlloc(Arena* pArena, i64 size, i64 align, bool uninitialized) {
 	Assert(pArena);
 
+	if (pArena->flags & AF_CONCURRENT)
+		return ArenaAllocConcurrent(pArena, size, align, uninitialized);
+	if (pArena->flags & AF_GUARD_PAGES)
+		return ArenaAllocGuarded(pArena, size, align, uninitialized);
+
 	void* pMemory = nullptr;
 
 	pMemory = AlignPtr(pArena->pCurrentHead, align);
 	u8* pEnd = (u8*)pMemory + size;
 
 	if (pEnd > pArena->pFirstUncommittedPage) {
+		if (pEnd >= pArena->pAddressLimit && (pArena->flags & AF_CHAINED)) {
+			ArenaAddChunk(pArena, size + ARENA_REDZONE, align);
+			pMemory = AlignPtr(pArena->pCurrentHead, align);
+			pEnd = (u8*)pMemory + size;
+		}
 		Assert(pEnd < pArena->pAddressLimit);
-		ArenaExpandCommitted(pArena, pEnd);
+		if (pEnd > pArena->pFirstUncommittedPage)
+			ArenaExpandCommitted(pArena, pEnd);
 	}
 
-	pArena->pCurrentHead = pEnd;
+#ifdef ARENA_STATS
+	pArena->stats.allocationCount++;
+	pArena->stats.bytesRequested += size;
+	pArena->stats.bytesAlignmentWaste += (u8*)pMemory - pArena->pCurrentHead;
+#endif
 
-	if (!uninitialized) 
-		memset(pMemory, 0, size);
+	pArena->pCurrentHead = pEnd + ARENA_REDZONE;
+	ArenaZeroAndClaim(pArena, (u8*)pMemory, pEnd, uninitialized);
 	return pMemory;
 }
 
 // ***********************************************************************
 
+ArenaLargeBlock* ArenaFindLargeBlock(Arena* pArena, void* ptr) {
+	// Large blocks are the only allocations outside the arena's own reservations, anything inside is a normal one
+	u8* pAddress = (u8*)ptr;
+	if (pArena->pLargeBlocks == nullptr || (pAddress >= (u8*)pArena && pAddress < (u8*)pArena + pArena->reserveSize))
+		return nullptr;
+	for (ArenaChunk* pChunk = pArena->pChunks; pChunk; pChunk = pChunk->pPrev) {
+		if (pAddress >= (u8*)pChunk && pAddress < (u8*)pChunk + pChunk->reserveSize)
+			return nullptr;
+	}
+
+	// the word just before a large block's data points back at its header
+	ArenaLargeBlock* pBlock = ((ArenaLargeBlock**)ptr)[-1];
+	AssertMsg(pBlock->pData == ptr, "Pointer wasn't allocated from this arena");
+	return pBlock;
+}
+
+// ***********************************************************************
+
+void ArenaReleaseLargeBlocks(Arena* pArena, i64 fromSerial) {
+	// newest first, so the ones to release are always at the front of the list
+	ArenaLargeBlock* pBlock = pArena->pLargeBlocks;
+	while (pBlock && pBlock->serial >= fromSerial) {
+		ArenaLargeBlock* pNext = pBlock->pNext;
+#ifdef MEMORY_TRACKING
+		if (!pArena->noTrack)
+			CheckFree(pBlock);
+#endif
+		VirtualRelease((u8*)pBlock, pBlock->reserveSize);
+		pBlock = pNext;
+	}
+	pArena->pLargeBlocks = pBlock;
+	if (pBlock)
+		pBlock->pPrev = nullptr;
+}
+
+// ***********************************************************************
+
+void* ArenaAllocLargeBlock(Arena* pArena, i64 size, i64 align) {
+	// Reserve well ahead so the common doubling growth pattern mostly just commits more pages
+	i64 pageSize = VirtualPageSize();
+	i64 dataOffset = Align(sizeof(ArenaLargeBlock) + sizeof(ArenaLargeBlock*), align); // room for the back pointer
+	i64 committedSize = Align(dataOffset + size, pageSize);
+	i64 reserveSize = Align((dataOffset + size) * 4, pageSize);
+
+	u8* pMemory = VirtualReserve(reserveSize);
+	Assert(pMemory != nullptr);
+	VirtualCommit(pMemory, committedSize);
+#ifdef MEMORY_TRACKING
+	if (!pArena->noTrack)
+		CheckMalloc(pMemory, committedSize);
+#endif
+
+	ArenaLargeBlock* pBlock = (ArenaLargeBlock*)pMemory;
+	pBlock->pData = pMemory + dataOffset;
+	((ArenaLargeBlock**)pBlock->pData)[-1] = pBlock;
+	pBlock->reserveSize = reserveSize;
+	pBlock->committedSize = committedSize;
+	pBlock->serial = pArena->nextLargeBlockSerial++;
+	pBlock->pPrev = nullptr;
+	pBlock->pNext = pArena->pLargeBlocks;
+	if (pArena->pLargeBlocks)
+		pArena->pLargeBlocks->pPrev = pBlock;
+	pArena->pLargeBlocks = pBlock;
+	return pBlock->pData;
+}
+
+// ***********************************************************************
+
+void* ArenaGrowLargeBlock(Arena* pArena, ArenaLargeBlock* pBlock, i64 size, i64 oldSize) {
+	u8* pBase = (u8*)pBlock;
+	i64 dataOffset = pBlock->pData - pBase;
+	i64 requiredSize = Align(dataOffset + size, VirtualPageSize());
+
+	if (requiredSize > pBlock->reserveSize) {
+		// Out of reservation, remap the pages somewhere bigger, or copy if the platform can't
+		i64 newReserveSize = requiredSize * 2;
+		i64 oldReserveSize = pBlock->reserveSize;
+		i64 oldCommittedSize = pBlock->committedSize;
+		u8* pNewBase = VirtualRemap(pBase, oldReserveSize, newReserveSize);
+		i64 newCommittedSize = newReserveSize;
+		if (pNewBase == nullptr) {
+			pNewBase = VirtualReserve(newReserveSize);
+			Assert(pNewBase != nullptr);
+			VirtualCommit(pNewBase, requiredSize);
+			memcpy(pNewBase, pBase, dataOffset + oldSize);
+			VirtualRelease(pBase, oldReserveSize);
+			newCommittedSize = requiredSize;
+		}
+#ifdef MEMORY_TRACKING
+		if (!pArena->noTrack)
+			CheckRealloc(pNewBase, pBase, newCommittedSize, oldCommittedSize);
+#endif
+
+		// The header moved with the data, so fix up the list around it
+		pBlock = (ArenaLargeBlock*)pNewBase;
+		pBlock->pData = pNewBase + dataOffset;
+		((ArenaLargeBlock**)pBlock->pData)[-1] = pBlock;
+		pBlock->reserveSize = newReserveSize;
+		pBlock->committedSize = newCommittedSize;
+		if (pBlock->pPrev)
+			pBlock->pPrev->pNext = pBlock;
+		else
+			pArena->pLargeBlocks = pBlock;
+		if (pBlock->pNext)
+			pBlock->pNext->pPrev = pBlock;
+	}
+	else if (requiredSize > pBlock->committedSize) {
+		VirtualCommit(pBase + pBlock->committedSize, requiredSize - pBlock->committedSize);
+#ifdef MEMORY_TRACKING
+		if (!pArena->noTrack)
+			CheckRealloc(pBase, pBase, requiredSize, pBlock->committedSize);
+#endif
+		pBlock->committedSize = requiredSize;
+	}
+	return pBlock->pData;
+}
+
+// ***********************************************************************
+
 void* ArenaRealloc(Arena* pArena, void* ptr, i64 size, i64 oldSize, i64 align, bool uninitialized) {
 	Assert(pArena);
 
+#ifdef ARENA_STATS
+	if (pArena->flags & AF_CONCURRENT)
+		AtomicAdd(&pArena->stats.reallocCount, 1);
+	else
+		pArena->stats.reallocCount++;
+#endif
+
 	// easiest case, reduction in size, just give it back what it asked for
 	// we memset the unused memory now to prevent use after frees
 	if (size < oldSize) {
@@ -132,33 +698,327 @@ void* ArenaRealloc(Arena* pArena, void* ptr, i64 size, i64 oldSize, i64 align, b
 		return ptr;
 	}
 
+	// blocks that already live in their own reservation can always grow without copying
+	if (pArena->pLargeBlocks && ptr) {
+		if (ArenaLargeBlock* pBlock = ArenaFindLargeBlock(pArena, ptr)) {
+			// no need to zero, everything past the block's size is either fresh pages or was zeroed when it shrank
+			return ArenaGrowLargeBlock(pArena, pBlock, size, oldSize);
+		}
+	}
+
 	// if the current head is in fact the end of the current allocation, then you can just move the head
 	u8* pCurrentEnd = (u8*)ptr + oldSize;
-	if (pCurrentEnd == pArena->pCurrentHead) {
+	if (pArena->flags & AF_CONCURRENT) {
+		// same again, but we must win the race for the head to grow in place
+		u8* pClaimedEnd = AlignPtr(pCurrentEnd, CONCURRENT_ARENA_ALIGN);
+		u8* pNewEnd = AlignPtr((u8*)ptr + size, CONCURRENT_ARENA_ALIGN);
+		if (ptr && AtomicCompareExchange((volatile i64*)&pArena->pCurrentHead, i64(pClaimedEnd), i64(pNewEnd))) {
+			ArenaCommitConcurrent(pArena, pNewEnd);
+			ArenaUnpoison(pCurrentEnd, size - oldSize);
+			if (!uninitialized) 
+				memset(pCurrentEnd, 0, size - oldSize);
+			return ptr;
+		}
+	}
+	else if (pCurrentEnd + ARENA_REDZONE == pArena->pCurrentHead && ((u8*)ptr + size < pArena->pAddressLimit || !(pArena->flags & AF_CHAINED))) {
 		u8* pNewEnd = (u8*)ptr + size;
 		if (pNewEnd > pArena->pFirstUncommittedPage) {
 			Assert(pNewEnd < pArena->pAddressLimit);
 			ArenaExpandCommitted(pArena, pNewEnd);
 		}
 
-		if (!uninitialized) 
-			memset(pArena->pCurrentHead, 0, pNewEnd - pCurrentEnd);
-		pArena->pCurrentHead = pNewEnd;
+		ArenaZeroAndClaim(pArena, pCurrentEnd, pNewEnd, uninitialized);
+		pArena->pCurrentHead = pNewEnd + ARENA_REDZONE;
 		return ptr;
 	}
 
-	// worst case, move the memory
-	u8* pOutput = (u8*)ArenaAlloc(pArena, size, align, false);
-	if (!uninitialized) 
-		memset(pOutput, 0, size);
+	// worst case, move the memory. Big blocks move to their own reservation so this is the last copy they need
+	// Large blocks are fresh pages so they're already zero, and ArenaAlloc only zeroes what might be dirty
+	u8* pOutput;
+	if (size >= ARENA_LARGE_BLOCK_SIZE && align <= VirtualPageSize() && !(pArena->flags & (AF_CONCURRENT | AF_GUARD_PAGES)))
+		pOutput = (u8*)ArenaAllocLargeBlock(pArena, size, align);
+	else
+		pOutput = (u8*)ArenaAlloc(pArena, size, align, uninitialized);
 	memcpy(pOutput, ptr, oldSize);
+	// concurrent arenas get here when another thread won the race to grow in place
+	if (pArena->flags & AF_CONCURRENT) {
+		AtomicAdd(&pArena->stats.bytesAbandoned, oldSize);
+#ifdef ARENA_STATS
+		AtomicAdd(&pArena->stats.reallocCopies, 1);
+#endif
+	} else {
+		pArena->stats.bytesAbandoned += oldSize;
+#ifdef ARENA_STATS
+		pArena->stats.reallocCopies++;
+#endif
+	}
 	return (void*)pOutput;
 }
 
 // ***********************************************************************
 
+void* ArenaAllocReleasable(Arena* pArena, i64 size, i64 align, bool uninitialized) {
+	Assert(pArena);
+
+	// same rules as ArenaRealloc for when a block can live on its own, large blocks are fresh pages so already zero
+	if (size >= ARENA_LARGE_BLOCK_SIZE && align <= VirtualPageSize() && !(pArena->flags & (AF_CONCURRENT | AF_GUARD_PAGES)))
+		return ArenaAllocLargeBlock(pArena, size, align);
+	return ArenaAlloc(pArena, size, align, uninitialized);
+}
+
+// ***********************************************************************
+
+void ArenaFree(Arena* pArena, void* ptr, i64 size) {
+	Assert(pArena);
+
+	ArenaLargeBlock* pBlock = ptr && pArena->pLargeBlocks ? ArenaFindLargeBlock(pArena, ptr) : nullptr;
+	if (pBlock == nullptr) {
+		if (pArena->flags & AF_CONCURRENT)
+			AtomicAdd(&pArena->stats.bytesAbandoned, size);
+		else
+			pArena->stats.bytesAbandoned += size;
+		return;
+	}
+
+	if (pBlock->pPrev)
+		pBlock->pPrev->pNext = pBlock->pNext;
+	else
+		pArena->pLargeBlocks = pBlock->pNext;
+	if (pBlock->pNext)
+		pBlock->pNext->pPrev = pBlock->pPrev;
+#ifdef MEMORY_TRACKING
+	if (!pArena->noTrack)
+		CheckFree(pBlock);
+#endif
+	VirtualRelease((u8*)pBlock, pBlock->reserveSize);
+}
+
+// ***********************************************************************
+
+#define HEAP_CACHE_BATCH 32 // blocks moved between a thread cache and the central lists at a time
+
+struct HeapCentralList {
+	SpinLock lock;
+	SlabFreeSlot* pFreeList;
+	i64 count;
+};
+
+struct HeapState {
+	Arena* pArena;
+	u8* pSpanClasses; // size class of every span in the reservation, indexed by offset / HEAP_SPAN_SIZE
+	u8* pSpanBase;
+	SpinLock spanLock;
+	HeapCentralList central[HEAP_SIZE_CLASS_COUNT];
+	u8 classLookup[HEAP_MAX_SMALL_SIZE / 16 + 1]; // (size + 15) / 16 -> size class
+	i32 classSizes[HEAP_SIZE_CLASS_COUNT];
+};
+
+struct HeapThreadCache {
+	SlabFreeSlot* pFreeList[HEAP_SIZE_CLASS_COUNT];
+	i64 count[HEAP_SIZE_CLASS_COUNT];
+};
+
+// Large allocations carry this just before the pointer we hand out
+struct HeapLargeHeader {
+	i64 mappedSize;
+	i64 padding;
+};
+
+static HeapState* g_pHeap = nullptr;
+static SpinLock g_heapInitLock;
+thread_local HeapThreadCache t_heapCache;
+
+// ***********************************************************************
+
+HeapState* HeapGet() {
+	HeapState* pHeap = (HeapState*)AtomicLoad((volatile i64*)&g_pHeap);
+	if (pHeap)
+		return pHeap;
+
+	SpinLockAcquire(g_heapInitLock);
+	if (g_pHeap == nullptr) {
+		Arena* pArena = ArenaCreate(HEAP_RESERVE, true);
+		ArenaSetName(pArena, "Raw Heap");
+		pHeap = New(pArena, HeapState);
+		pHeap->pArena = pArena;
+		pHeap->pSpanClasses = New(pArena, u8, HEAP_RESERVE / HEAP_SPAN_SIZE, true); // fresh pages are already zero
+
+		// 16 byte steps up to 128, then 4 classes per power of two up to HEAP_MAX_SMALL_SIZE
+		for (i32 c = 0; c < HEAP_SIZE_CLASS_COUNT; c++) {
+			if (c < 8) {
+				pHeap->classSizes[c] = (c + 1) * 16;
+			} else {
+				i32 shift = 7 + (c - 8) / 4;
+				pHeap->classSizes[c] = (1 << shift) + ((c - 8) % 4 + 1) * (1 << (shift - 2));
+			}
+		}
+		i32 sizeClass = 0;
+		for (i32 i = 0; i <= HEAP_MAX_SMALL_SIZE / 16; i++) {
+			while (pHeap->classSizes[sizeClass] < i * 16)
+				sizeClass++;
+			pHeap->classLookup[i] = (u8)sizeClass;
+		}
+
+		// Spans are aligned so the span a pointer belongs to is just a shift away
+		pHeap->pSpanBase = (u8*)ArenaAlloc(pArena, 0, HEAP_SPAN_SIZE, true);
+		AtomicStore((volatile i64*)&g_pHeap, (i64)pHeap);
+	}
+	SpinLockRelease(g_heapInitLock);
+	return g_pHeap;
+}
+
+// ***********************************************************************
+
+bool HeapIsSmall(HeapState* pHeap, void* ptr) {
+	return (u8*)ptr >= pHeap->pSpanBase && (u8*)ptr < pHeap->pArena->pAddressLimit;
+}
+
+// ***********************************************************************
+
+void HeapRefillCache(HeapState* pHeap, i32 sizeClass) {
+	// Try to grab a batch of blocks other threads have given back first
+	HeapCentralList& central = pHeap->central[sizeClass];
+	SpinLockAcquire(central.lock);
+	SlabFreeSlot* pFirst = central.pFreeList;
+	SlabFreeSlot* pLast = nullptr;
+	i64 taken = 0;
+	for (SlabFreeSlot* pSlot = pFirst; pSlot && taken < HEAP_CACHE_BATCH; pSlot = pSlot->pNext) {
+		pLast = pSlot;
+		taken++;
+	}
+	if (pLast) {
+		central.pFreeList = pLast->pNext;
+		central.count -= taken;
+	}
+	SpinLockRelease(central.lock);
+
+	if (pLast) {
+		pLast->pNext = t_heapCache.pFreeList[sizeClass];
+		t_heapCache.pFreeList[sizeClass] = pFirst;
+		t_heapCache.count[sizeClass] += taken;
+		return;
+	}
+
+	// Otherwise carve a new span, which only this thread can see until it's handed out
+	SpinLockAcquire(pHeap->spanLock);
+	u8* pSpan = nullptr;
+	if (pHeap->pArena->pCurrentHead + HEAP_SPAN_SIZE < pHeap->pArena->pAddressLimit) {
+		pSpan = (u8*)ArenaAlloc(pHeap->pArena, HEAP_SPAN_SIZE, HEAP_SPAN_SIZE, true);
+		pHeap->pSpanClasses[(pSpan - pHeap->pSpanBase) / HEAP_SPAN_SIZE] = (u8)sizeClass;
+	}
+	SpinLockRelease(pHeap->spanLock);
+	AssertMsg(pSpan != nullptr, "Heap reservation exhausted");
+
+	i64 blockSize = pHeap->classSizes[sizeClass];
+	i64 blockCount = HEAP_SPAN_SIZE / blockSize;
+	for (i64 i = blockCount - 1; i >= 0; i--) {
+		SlabFreeSlot* pSlot = (SlabFreeSlot*)(pSpan + i * blockSize);
+		pSlot->pNext = t_heapCache.pFreeList[sizeClass];
+		t_heapCache.pFreeList[sizeClass] = pSlot;
+	}
+	t_heapCache.count[sizeClass] += blockCount;
+}
+
+// ***********************************************************************
+
+void HeapReleaseToCentral(HeapState* pHeap, i32 sizeClass, i64 blockCount) {
+	SlabFreeSlot* pFirst = t_heapCache.pFreeList[sizeClass];
+	if (pFirst == nullptr || blockCount <= 0)
+		return;
+
+	SlabFreeSlot* pLast = pFirst;
+	i64 moved = 1;
+	while (moved < blockCount && pLast->pNext) {
+		pLast = pLast->pNext;
+		moved++;
+	}
+	t_heapCache.pFreeList[sizeClass] = pLast->pNext;
+	t_heapCache.count[sizeClass] -= moved;
+
+	HeapCentralList& central = pHeap->central[sizeClass];
+	SpinLockAcquire(central.lock);
+	pLast->pNext = central.pFreeList;
+	central.pFreeList = pFirst;
+	central.count += moved;
+	SpinLockRelease(central.lock);
+}
+
+// ***********************************************************************
+
+void* HeapAllocBlock(i64 size) {
+	HeapState* pHeap = HeapGet();
+
+	if (size > HEAP_MAX_SMALL_SIZE) {
+		// Big enough that the OS page allocator is the right tool, and it gives the pages back on free
+		i64 mappedSize = Align(size + sizeof(HeapLargeHeader), VirtualPageSize());
+		u8* pMemory = VirtualReserve(mappedSize);
+		Assert(pMemory != nullptr);
+		VirtualCommit(pMemory, mappedSize);
+		HeapLargeHeader* pHeader = (HeapLargeHeader*)pMemory;
+		pHeader->mappedSize = mappedSize;
+		return pMemory + sizeof(HeapLargeHeader);
+	}
+
+	i32 sizeClass = pHeap->classLookup[(size + 15) / 16];
+	if (t_heapCache.pFreeList[sizeClass] == nullptr)
+		HeapRefillCache(pHeap, sizeClass);
+
+	SlabFreeSlot* pSlot = t_heapCache.pFreeList[sizeClass];
+	t_heapCache.pFreeList[sizeClass] = pSlot->pNext;
+	t_heapCache.count[sizeClass]--;
+	return pSlot;
+}
+
+// ***********************************************************************
+
+i64 HeapBlockSize(HeapState* pHeap, void* ptr) {
+	if (HeapIsSmall(pHeap, ptr))
+		return pHeap->classSizes[pHeap->pSpanClasses[((u8*)ptr - pHeap->pSpanBase) / HEAP_SPAN_SIZE]];
+	HeapLargeHeader* pHeader = (HeapLargeHeader*)((u8*)ptr - sizeof(HeapLargeHeader));
+	return pHeader->mappedSize - sizeof(HeapLargeHeader);
+}
+
+// ***********************************************************************
+
+void HeapFreeBlock(void* ptr) {
+	HeapState* pHeap = HeapGet();
+
+	if (!HeapIsSmall(pHeap, ptr)) {
+		HeapLargeHeader* pHeader = (HeapLargeHeader*)((u8*)ptr - sizeof(HeapLargeHeader));
+		VirtualRelease((u8*)pHeader, pHeader->mappedSize);
+		return;
+	}
+
+	i32 sizeClass = pHeap->pSpanClasses[((u8*)ptr - pHeap->pSpanBase) / HEAP_SPAN_SIZE];
+	SlabFreeSlot* pSlot = (SlabFreeSlot*)ptr;
+	pSlot->pNext = t_heapCache.pFreeList[sizeClass];
+	t_heapCache.pFreeList[sizeClass] = pSlot;
+	t_heapCache.count[sizeClass]++;
+
+	// Don't let one thread hoard everything it frees
+	if (t_heapCache.count[sizeClass] > 2 * HEAP_CACHE_BATCH)
+		HeapReleaseToCentral(pHeap, sizeClass, HEAP_CACHE_BATCH);
+}
+
+// ***********************************************************************
+
+void HeapThreadCacheFlush() {
+	if (g_pHeap == nullptr)
+		return;
+
+	for (i32 c = 0; c < HEAP_SIZE_CLASS_COUNT; c++) {
+		HeapReleaseToCentral(g_pHeap, c, t_heapCache.count[c]);
+	}
+}
+
+// ***********************************************************************
+
 void* RawAlloc(i64 size, bool uninitialized) {
+#ifdef RAW_ALLOC_CRT
     void* pMemory = malloc(size);
+#else
+    void* pMemory = HeapAllocBlock(size);
+#endif
 #ifdef MEMORY_TRACKING
 	CheckMalloc(pMemory, size);
 #endif
@@ -170,9 +1030,24 @@ void* RawAlloc(i64 size, bool uninitialized) {
 // ***********************************************************************
 
 void* RawRealloc(void* ptr, i64 size, i64 oldSize, bool uninitialized) {
+#ifdef RAW_ALLOC_CRT
 	void* pMemory = realloc(ptr, size);
+#else
+	void* pMemory = ptr;
+	if (ptr == nullptr || size > HeapBlockSize(HeapGet(), ptr)) {
+		pMemory = HeapAllocBlock(size);
+		if (ptr)
+			memcpy(pMemory, ptr, oldSize < size ? oldSize : size);
+	}
+#endif
 #ifdef MEMORY_TRACKING
+    // Record before the old block is freed, otherwise another thread could be handed its address and
+    // have its allocation sequenced before our free of it
     CheckRealloc(pMemory, ptr, size, oldSize);
+#endif
+#ifndef RAW_ALLOC_CRT
+	if (pMemory != ptr && ptr)
+		HeapFreeBlock(ptr);
 #endif
 	if (!uninitialized && size > oldSize) {
 		char* pStart = (char*)pMemory + oldSize;
@@ -184,8 +1059,14 @@ void* RawRealloc(void* ptr, i64 size, i64 oldSize, bool uninitialized) {
 // ***********************************************************************
 
 void RawFree(void* ptr) {
+	if (ptr == nullptr)
+		return;
 #ifdef MEMORY_TRACKING
     CheckFree(ptr);
 #endif
+#ifdef RAW_ALLOC_CRT
     free(ptr);
+#else
+    HeapFreeBlock(ptr);
+#endif
 }
@@ -7,10 +7,74 @@
 // ************************************************
 
 #define DEFAULT_RESERVE 268435456  // 256 megas
+#define ARENA_RETENTION_WINDOW 16  // max number of resets the retention high water mark can look back over
+#define ARENA_LARGE_BLOCK_SIZE 1048576  // reallocs that can't grow in place move to their own reservation from this size
 
 u64 Align(u64 toAlign, u64 alignment);
 u8* AlignPtr(u8* toAlign, u64 alignment);
 
+enum ArenaFlags : u32 {
+	AF_NONE = 0,
+	AF_HUGE_PAGES = 1 << 1,  // Back the reservation with transparent huge pages, commits happen in huge page sized steps
+	AF_HUGETLB = 1 << 2,     // Reserve explicit huge pages up front (MAP_HUGETLB), falls back to AF_HUGE_PAGES if none are available
+	AF_CONCURRENT = 1 << 3,  // ArenaAlloc/ArenaRealloc may be called from many threads at once. Reset, temps and Finished still may not
+	AF_CHAINED = 1 << 4,     // When the reservation runs out, link in another one instead of asserting. Not compatible with AF_CONCURRENT
+	AF_GUARD_PAGES = 1 << 5, // Debug mode, every allocation gets its own pages with an inaccessible page right after it, and reset or
+	                         // temp end decommits what was freed. Catches overruns and use after reset at the faulting instruction.
+	                         // Costs at least two pages per allocation. Not compatible with AF_CONCURRENT
+};
+
+// When built with AddressSanitizer, arenas poison their unallocated and reset memory, and leave a poisoned
+// redzone of this many bytes after every allocation so overruns into the next block are caught
+#define ARENA_ASAN_REDZONE 16
+
+// Concurrent arenas keep the head aligned to this, so allocations at or below it need no padding
+#define CONCURRENT_ARENA_ALIGN 16
+
+// Big realloc'd blocks that couldn't grow at the head live in their own reservation, which can grow
+// (or on linux be remapped) without copying. They live until the arena is reset or finished, or the temp
+// region they were made in ends. The word just before pData points back at the header
+struct ArenaLargeBlock {
+	ArenaLargeBlock* pNext;
+	ArenaLargeBlock* pPrev;
+	u8* pData;
+	i64 reserveSize;
+	i64 committedSize;
+	i64 serial; // blocks are numbered in the order they're made, the list is newest first
+};
+
+// Extra reservations linked in by chained arenas. Sits at the start of its reservation and remembers the
+// region that was active before it, so we can step back to it on temp end or reset
+struct ArenaChunk {
+	ArenaChunk* pPrev;
+	i64 reserveSize;
+	u8* pSavedBase;
+	u8* pSavedHead;
+	u8* pSavedFirstUncommittedPage;
+	u8* pSavedAddressLimit;
+	u8* pSavedZeroedFrom;
+	i64 savedGuardBytes;
+};
+
+// Per arena counters. The ones on the allocation fast path are only collected when ARENA_STATS is defined,
+// the rest are always kept since they're only touched on slow paths
+struct ArenaStats {
+	// ARENA_STATS only
+	i64 allocationCount;
+	i64 bytesRequested;
+	i64 bytesAlignmentWaste;
+	i64 reallocCount;
+	i64 reallocCopies;
+
+	// always collected
+	i64 peakUsed; // highest head position seen, updated lazily on reset/temp end and when queried
+	i64 resetCount;
+	i64 commitCount;
+	i64 decommitCount;
+	i64 bytesDecommitted;
+	i64 bytesAbandoned; // old blocks left dead in the arena when a realloc had to move them, or ArenaFree couldn't release them
+};
+
 struct Arena {
 	const char* name;
 	i64 pageSize;
@@ -20,7 +84,32 @@ struct Arena {
 	u8* pCurrentHead;
 	u8* pFirstUncommittedPage;
 	u8* pAddressLimit;
+	u8* pZeroedFrom; // nothing from here up has been handed out since it was committed, so it's still zero
 	bool noTrack;
+	u32 flags;
+	i64 guardBytes; // AF_GUARD_PAGES, guard pages below pFirstUncommittedPage, they're skipped rather than committed
+
+	// Serialises page commits in concurrent arenas
+	SpinLock commitLock;
+
+	// Decommit on reset policy, see ArenaSetRetention
+	i64 retainMinimum;
+	i64 retainWindow;
+	i64 retainCycles;
+	i64 highWaterHistory[ARENA_RETENTION_WINDOW];
+
+	ArenaLargeBlock* pLargeBlocks;
+	i64 nextLargeBlockSerial;
+
+	// Chained arenas, the base/head/limit pointers above describe the newest chunk's region
+	ArenaChunk* pChunks;
+	i64 chainedBytes; // bytes used in the regions before the current one
+
+	ArenaStats stats;
+
+	// List of all live arenas, see ArenaForEach
+	Arena* pNextArena;
+	Arena* pPrevArena;
 };
 
 // Global shared arena's. You must create and release these yourself
@@ -30,15 +119,64 @@ struct Arena {
 extern Arena* g_pArenaFrame;
 extern Arena* g_pArenaPermenant;
 
-Arena* ArenaCreate(i64 defaultReserve = DEFAULT_RESERVE, bool noTrack=false);
+Arena* ArenaCreate(i64 defaultReserve = DEFAULT_RESERVE, bool noTrack=false, u32 flags=AF_NONE);
 void ArenaReset(Arena* pArena);
 void ArenaFinished(Arena* pArena);
 void ArenaExpandCommitted(Arena* pArena, u8* pDesiredEnd);
+void ArenaShrinkCommitted(Arena* pArena, u8* pDesiredEnd, i64 guardBytesKept = 0); // guard page arenas say how many guard bytes are below pDesiredEnd
+void ArenaReleaseLargeBlocks(Arena* pArena, i64 fromSerial = 0); // releases the blocks made since fromSerial, or all of them
+void ArenaReleaseChunks(Arena* pArena, u8* pKeepHead = nullptr); // steps back to the region holding pKeepHead, or the first one
+
+// By default reset keeps everything committed. Once this is set, each reset will decommit any pages above
+// the highest head seen over the last "window" resets (or minRetainedBytes, whichever is larger)
+// A window of 0 turns this off again
+void ArenaSetRetention(Arena* pArena, i64 minRetainedBytes, i32 window);
+
+// Telemetry
+void ArenaSetName(Arena* pArena, const char* name);
+i64 ArenaUsedBytes(Arena* pArena);
+i64 ArenaCommittedBytes(Arena* pArena); // includes large blocks and chunks
+ArenaStats ArenaGetStats(Arena* pArena);
+
+// Calls the callback for every live arena. Don't create or finish arenas from inside the callback
+typedef void (*ArenaVisitor)(Arena*, void*);
+void ArenaForEach(ArenaVisitor visitor, void* pUserData);
+void ReportArenaUsage(); // logs stats for every live arena
+
+// Temporary regions
+// Take a snapshot of the arena head and roll back to it later, freeing everything allocated in between
+struct ArenaTemp {
+	Arena* pArena;
+	u8* pSavedHead;
+	i64 savedLargeBlockSerial; // large blocks from this one on were made inside the region
+	i64 savedGuardBytes;
+};
+
+ArenaTemp ArenaTempBegin(Arena* pArena);
+void ArenaTempEnd(ArenaTemp temp);
+
+// Thread local scratch arenas for temporary work inside functions. Pass in the arena your results are
+// going to (if any) and you'll be given a scratch arena that's guaranteed to be a different one
+ArenaTemp ScratchBegin(Arena* pConflict = nullptr);
+void ScratchEnd(ArenaTemp temp);
+void ScratchArenasRelease(); // call before a thread exits if it used scratch arenas
+// The other per thread state to give back when a thread exits is HeapThreadCacheFlush, Log::ThreadRingRelease and
+// MemoryTrackingThreadRelease, each only matters if the thread used that part of the library
+
+// Scope helpers, the temp region is ended automatically when the scope exits (see defer.h)
+#define ArenaTempScope(name, pArena) ArenaTemp name = ArenaTempBegin(pArena); defer(ArenaTempEnd(name))
+#define ScratchScope(name, pConflict) ArenaTemp name = ScratchBegin(pConflict); defer(ScratchEnd(name))
 
 // Core arena allocation functions. Ostensibly everything should come through here, with minimal use of raw allocation
 void* ArenaAlloc(Arena* arena, i64 size, i64 align, bool uninitialized = false); 
 void* ArenaRealloc(Arena* arena, void* ptr, i64 newSize, i64 oldSize, i64 align, bool uninitialized = false); 
 
+// For big buffers that get replaced wholesale, like hash tables when they grow. Blocks of at least
+// ARENA_LARGE_BLOCK_SIZE get their own reservation, and ArenaFree hands those straight back to the OS rather
+// than leaving them dead in the arena until reset. Smaller blocks come from the arena as normal
+void* ArenaAllocReleasable(Arena* arena, i64 size, i64 align, bool uninitialized = false);
+void ArenaFree(Arena* arena, void* ptr, i64 size); // anything that isn't a large block stays until reset
+
 #define New2(pArena, type) (type*)ArenaAlloc(pArena, sizeof(type), alignof(type), false)
 #define New3(pArena, type, count) (type*)ArenaAlloc(pArena, sizeof(type)*count, alignof(type), false)
 #define New4(pArena, type, count, uninit) (type*)ArenaAlloc(pArena, sizeof(type)*count, alignof(type), uninit)
@@ -49,6 +187,25 @@ void* ArenaRealloc(Arena* arena, void* ptr, i64 newSize, i64 oldSize, i64 align,
 #define New(...) Get5thArg(__VA_ARGS__,New4,New3,New2)(__VA_ARGS__)
 
 
+// ************************************************
+// Virtual memory
+// ************************************************
+
+// Thin layer over the OS page allocator, implemented per platform (memory_win32.cpp, memory_linux.cpp)
+// Reserved memory has no backing until committed, and committed memory always starts out zeroed
+
+i64 VirtualPageSize();
+i64 VirtualHugePageSize();
+u8* VirtualReserve(i64 size, u32 flags = AF_NONE);
+bool VirtualCommit(u8* pAddress, i64 size);
+void VirtualDecommit(u8* pAddress, i64 size);
+void VirtualRelease(u8* pAddress, i64 size);
+
+// Grows a fully committed range to newSize, possibly moving it, without copying the contents. The whole new
+// range is committed on return. Returns nullptr if the platform can't do this (then you must copy yourself)
+u8* VirtualRemap(u8* pAddress, i64 oldSize, i64 newSize);
+
+
 // ************************************************
 // Raw (system) allocators
 // ************************************************
@@ -60,10 +217,23 @@ inline void* operator new(u64, NewWrapper, void* ptr) {
 inline void operator delete(void*, NewWrapper, void*) {}
 #define PlacementNew(ptr) new (NewWrapper(), ptr)
 
+// Raw allocations come from a size class heap rather than the CRT. Small sizes are rounded up to one of
+// HEAP_SIZE_CLASS_COUNT classes and served from per thread free lists, refilled in batches from 64k spans
+// carved out of one big arena reservation. Anything over HEAP_MAX_SMALL_SIZE goes straight to the OS.
+// Define RAW_ALLOC_CRT to go back to plain malloc/free (handy for external leak checkers)
+
+#define HEAP_RESERVE 17179869184ull // 16 gigs of address space for small allocations
+#define HEAP_SPAN_SIZE 65536
+#define HEAP_MAX_SMALL_SIZE 32768
+#define HEAP_SIZE_CLASS_COUNT 40
+
 void* RawAlloc(i64 size, bool uninitialized = false);
 void* RawRealloc(void* ptr, i64 size, i64 oldSize, bool uninitialized = false);
 void RawFree(void* ptr);
 
+// Blocks freed by a thread are cached on that thread, call this before a thread exits to give them back
+void HeapThreadCacheFlush();
+
 #define RawNew1(type) (type*)RawAlloc(sizeof(type))
 #define RawNew2(type, count) (type*)RawAlloc(sizeof(type)*count)
 #define RawNew3(type, count, uninit) (type*)RawAlloc(sizeof(type)*count, uninit)
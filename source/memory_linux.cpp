@@ -0,0 +1,113 @@
+// Copyright 2020-2022 David Colson. All rights reserved.
+
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ***********************************************************************
+
+i64 VirtualPageSize() {
+	static i64 pageSize = 0;
+	if (pageSize == 0)
+		pageSize = sysconf(_SC_PAGESIZE);
+	return pageSize;
+}
+
+// ***********************************************************************
+
+i64 VirtualHugePageSize() {
+	static i64 hugePageSize = 0;
+	if (hugePageSize == 0) {
+		hugePageSize = 2 * 1024 * 1024; // x64 default if the kernel won't tell us
+		FILE* pFile = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+		if (pFile) {
+			long long size = 0;
+			if (fscanf(pFile, "%lld", &size) == 1 && size > 0)
+				hugePageSize = size;
+			fclose(pFile);
+		}
+	}
+	return hugePageSize;
+}
+
+// ***********************************************************************
+
+u8* VirtualReserve(i64 size, u32 flags) {
+	// PROT_NONE mappings cost nothing but address space, pages only get backing once committed and touched
+	int mapFlags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+#ifdef MAP_HUGETLB
+	if (flags & AF_HUGETLB) {
+		// No MAP_NORESERVE, we want this to fail now if the huge page pool is too small, not SIGBUS later
+		void* pMemory = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (pMemory != MAP_FAILED)
+			return (u8*)pMemory;
+	}
+#endif
+
+	if (flags & (AF_HUGE_PAGES | AF_HUGETLB)) {
+		// Transparent huge pages need huge page aligned ranges, so over reserve and trim off the ends
+		i64 hugePageSize = VirtualHugePageSize();
+		void* pMemory = mmap(nullptr, size + hugePageSize, PROT_NONE, mapFlags, -1, 0);
+		if (pMemory == MAP_FAILED)
+			return nullptr;
+
+		u8* pStart = (u8*)pMemory;
+		u8* pAligned = AlignPtr(pStart, hugePageSize);
+		u8* pEnd = pStart + size + hugePageSize;
+		if (pAligned > pStart)
+			munmap(pStart, pAligned - pStart);
+		if (pEnd > pAligned + size)
+			munmap(pAligned + size, pEnd - (pAligned + size));
+
+#ifdef MADV_HUGEPAGE
+		madvise(pAligned, size, MADV_HUGEPAGE);
+#endif
+		return pAligned;
+	}
+
+	void* pMemory = mmap(nullptr, size, PROT_NONE, mapFlags, -1, 0);
+	if (pMemory == MAP_FAILED)
+		return nullptr;
+	return (u8*)pMemory;
+}
+
+// ***********************************************************************
+
+bool VirtualCommit(u8* pAddress, i64 size) {
+	return mprotect(pAddress, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+// ***********************************************************************
+
+void VirtualDecommit(u8* pAddress, i64 size) {
+	// DONTNEED drops the physical pages, they'll come back zeroed if ever recommitted
+	madvise(pAddress, size, MADV_DONTNEED);
+	mprotect(pAddress, size, PROT_NONE);
+}
+
+// ***********************************************************************
+
+void VirtualRelease(u8* pAddress, i64 size) {
+	munmap(pAddress, size);
+}
+
+// ***********************************************************************
+
+u8* VirtualRemap(u8* pAddress, i64 oldSize, i64 newSize) {
+	// mremap can only move a single mapping, so make sure the committed and reserved parts are merged first.
+	// Committing is lazy on linux, untouched pages still cost nothing
+	if (mprotect(pAddress, oldSize, PROT_READ | PROT_WRITE) != 0)
+		return nullptr;
+
+	void* pMemory = mremap(pAddress, oldSize, newSize, MREMAP_MAYMOVE);
+	if (pMemory == MAP_FAILED)
+		return nullptr;
+	return (u8*)pMemory;
+}
+
+#endif
@@ -1,144 +1,562 @@
 // Copyright 2020-2022 David Colson. All rights reserved.
 
+#define MAX_TRACE_FRAMES 100
+#define FREED_HISTORY_SIZE 4096 // recently freed allocations remembered for double free reports
+
+// Stack traces are interned, every allocation made from the same callsite shares one copy of its trace
+struct StackTrace {
+    u64 hash;
+    void** pFrames;
+    u64 frameCount;
+};
+
+struct StackTraceKeyFuncs {
+    u64 Hash(const StackTrace& key) const {
+        return key.hash;
+    }
+    bool Cmp(const StackTrace& key1, const StackTrace& key2) const {
+        return key1.frameCount == key2.frameCount && memcmp(key1.pFrames, key2.pFrames, key1.frameCount * sizeof(void*)) == 0;
+    }
+};
+
 struct Allocation {
     void* pointer { nullptr };
     u64 size { 0 };
-    bool isLive { false };
+    i64 estimatedSize { 0 }; // size scaled up by the chance of this allocation being sampled
+    u32 allocTrace { 0 };    // index into the trace table
 	bool notALeak { false };
-    void* allocStackTrace[100];
-    u64 allocStackTraceFrames { 0 };
-    void* freeStackTrace[100];
-    u64 freeStackTraceFrames { 0 };
+};
+
+// Live allocations are the only ones kept in the table, this ring remembers the last few frees
+// so a double free can still tell you where the block came from and where it was first freed
+struct FreedAllocation {
+    void* pointer;
+    u32 allocTrace;
+    u32 freeTrace;
 };
 
 struct MemoryTrackerState {
 	Arena* pArena;
     HashMap<void*, Allocation> allocationTable;
+    HashMap<StackTrace, u32, StackTraceKeyFuncs> traceTable;
+    ResizableArray<StackTrace> traces;
+    FreedAllocation freedHistory[FREED_HISTORY_SIZE];
+    i64 freedCount;
 };
 
 static MemoryTrackerState* pMemTrack { nullptr };
 
+// Threads don't touch the tables above when they allocate. Each one appends events to its own buffer, and
+// the buffers are merged into the tables under a lock on demand (reports, usage queries) or when a buffer
+// fills up. So double and unknown frees are reported at merge time, though still with the offending trace
+#define TRACKER_BLOCK_SIZE 65536
+
+enum TrackerEventType : u32 {
+    TE_MALLOC,
+    TE_REALLOC,
+    TE_REALLOC_UNSAMPLED, // moved, but the sampler passed over the new block
+    TE_FREE,
+    TE_NOT_A_LEAK
+};
+
+struct TrackerEvent {
+    i64 sequence; // global order, so events from different threads can be replayed in the order they happened
+    TrackerEventType type;
+    u32 frameCount; // this many stack frames follow the event
+    void* pAllocated;
+    void* ptr;
+    u64 size;
+};
+
+struct TrackerEventBlock {
+    TrackerEventBlock* pNext; // set by the writer once it has moved on to a new block
+    volatile i64 committed;   // bytes of data that are fully written
+    u8 data[];
+};
+
+struct TrackerThread {
+    TrackerThread* pNext;
+    TrackerEventBlock* pWriteBlock; // owned by the thread
+    i64 writeOffset;
+    TrackerEventBlock* pReadBlock;  // owned by whoever holds the merge lock
+    i64 readOffset;
+    volatile i64 inFlight; // sequence of the event being written, -1 while getting one, 0 when idle
+    volatile i64 exited;   // set by the thread on its way out, the merge gives it back once it's drained
+};
+
+static volatile i64 g_trackerSequence { 0 };
+static TrackerThread* g_pTrackerThreads { nullptr };
+static SpinLock g_trackerMergeLock;
+thread_local TrackerThread* t_pTrackerThread { nullptr };
+static i64 g_sampleRate { MEMORY_TRACKING_SAMPLE_RATE };
+
+struct TrackerSampler {
+    u64 rngState;
+    i64 bytesUntilSample;
+};
+
+thread_local TrackerSampler t_sampler;
+
+// ***********************************************************************
+
+i64 NextSampleDistance() {
+    // xorshift64*, then take the top 53 bits as a uniform value in (0, 1]
+    t_sampler.rngState ^= t_sampler.rngState >> 12;
+    t_sampler.rngState ^= t_sampler.rngState << 25;
+    t_sampler.rngState ^= t_sampler.rngState >> 27;
+    f64 uniform = f64(((t_sampler.rngState * 0x2545F4914F6CDD1Dull) >> 11) + 1) / 9007199254740992.0;
+
+    // Gaps between sample points on a Poisson process are exponentially distributed
+    return i64(-log(uniform) * f64(g_sampleRate)) + 1;
+}
+
+// ***********************************************************************
+
+bool ShouldSample(u64 size) {
+    if (g_sampleRate <= 0)
+        return true;
+
+    if (t_sampler.rngState == 0) {
+        t_sampler.rngState = (u64)&t_sampler ^ 0x9E3779B97F4A7C15ull;
+        t_sampler.bytesUntilSample = NextSampleDistance();
+    }
+
+    // An allocation is sampled if any sample point lands inside it. The process is memoryless, so after a
+    // sample we can just draw a fresh distance from the end of this allocation
+    t_sampler.bytesUntilSample -= size;
+    if (t_sampler.bytesUntilSample > 0)
+        return false;
+    t_sampler.bytesUntilSample = NextSampleDistance();
+    return true;
+}
+
+// ***********************************************************************
+
+i64 EstimateSize(u64 size) {
+    if (g_sampleRate <= 0 || size == 0)
+        return size;
+
+    // Each sample stands in for 1/P(sampled) allocations like it
+    f64 probability = 1.0 - exp(-f64(size) / f64(g_sampleRate));
+    return i64(f64(size) / probability);
+}
+
+// ***********************************************************************
+
+void FlushMemoryTracking();
+
+void SetMemoryTrackingSampleRate(i64 meanBytesBetweenSamples) {
+    FlushMemoryTracking(); // events already recorded were sampled at the old rate
+    g_sampleRate = meanBytesBetweenSamples;
+    t_sampler.rngState = 0;
+}
+
 // ***********************************************************************
 
 void InitContext() {
 	Arena* pArena = ArenaCreate(DEFAULT_RESERVE, true);
+	ArenaSetName(pArena, "Memory Tracker");
     pMemTrack = New(pArena, MemoryTrackerState);
 	pMemTrack->pArena = pArena;
     pMemTrack->allocationTable.pArena = pArena;
+    pMemTrack->traceTable.pArena = pArena;
+    pMemTrack->traces.pArena = pArena;
 }
 
 // ***********************************************************************
 
-void CheckMalloc(void* pAllocated, u64 size) {
-    if (pMemTrack == nullptr)
-        InitContext();
+u32 InternStackTrace(void** pFrames, u64 frameCount) {
+    StackTrace trace;
+    trace.hash = HashBytes(pFrames, frameCount * sizeof(void*));
+    trace.pFrames = pFrames;
+    trace.frameCount = frameCount;
+
+    if (u32* pId = pMemTrack->traceTable.Get(trace))
+        return *pId;
+
+    // First time we've seen this callsite, keep our own copy of the frames
+    trace.pFrames = New(pMemTrack->pArena, void*, frameCount, true);
+    memcpy(trace.pFrames, pFrames, frameCount * sizeof(void*));
+    u32 id = (u32)pMemTrack->traces.count;
+    pMemTrack->traces.PushBack(trace);
+    pMemTrack->traceTable.Add(trace, id);
+    return id;
+}
+
+// ***********************************************************************
+
+String PrintTrace(u32 traceId, Arena* pArena) {
+    StackTrace& trace = pMemTrack->traces[traceId];
+    return Debug::PrintStackTraceToString(trace.pFrames, trace.frameCount, pArena);
+}
+
+// ***********************************************************************
+
+void RecordFree(Allocation& alloc, u32 freeTrace) {
+    FreedAllocation& freed = pMemTrack->freedHistory[pMemTrack->freedCount % FREED_HISTORY_SIZE];
+    freed.pointer = alloc.pointer;
+    freed.allocTrace = alloc.allocTrace;
+    freed.freeTrace = freeTrace;
+    pMemTrack->freedCount++;
+}
+
+// ***********************************************************************
+
+TrackerEventBlock* TrackerNewBlock() {
+    TrackerEventBlock* pBlock = (TrackerEventBlock*)VirtualReserve(TRACKER_BLOCK_SIZE);
+    VirtualCommit((u8*)pBlock, TRACKER_BLOCK_SIZE);
+    return pBlock; // fresh pages from the OS are already zero
+}
 
+// ***********************************************************************
+
+TrackerThread* TrackerRegisterThread() {
+    TrackerThread* pThread = (TrackerThread*)VirtualReserve(VirtualPageSize());
+    VirtualCommit((u8*)pThread, VirtualPageSize());
+    pThread->pWriteBlock = TrackerNewBlock();
+    pThread->pReadBlock = pThread->pWriteBlock;
+
+    // Lock free push, only the merge unlinks and it does so under the merge lock
+    i64 head;
+    do {
+        head = AtomicLoad((volatile i64*)&g_pTrackerThreads);
+        pThread->pNext = (TrackerThread*)head;
+    } while (!AtomicCompareExchange((volatile i64*)&g_pTrackerThreads, head, (i64)pThread));
+
+    t_pTrackerThread = pThread;
+    return pThread;
+}
+
+// ***********************************************************************
+
+TrackerEvent* TrackerPeekEvent(TrackerThread* pThread) {
+    while (true) {
+        TrackerEventBlock* pBlock = pThread->pReadBlock;
+
+        // Load next before committed, if the writer had moved on then everything it will ever write here is visible
+        TrackerEventBlock* pNext = (TrackerEventBlock*)AtomicLoad((volatile i64*)&pBlock->pNext);
+        i64 committed = AtomicLoad(&pBlock->committed);
+        if (pThread->readOffset < committed)
+            return (TrackerEvent*)(pBlock->data + pThread->readOffset);
+        if (pNext == nullptr)
+            return nullptr;
+
+        pThread->pReadBlock = pNext;
+        pThread->readOffset = 0;
+        VirtualRelease((u8*)pBlock, TRACKER_BLOCK_SIZE);
+    }
+}
+
+// ***********************************************************************
+
+void ApplyMalloc(TrackerEvent* pEvent, u32 trace) {
     Allocation allocation;
-    allocation.pointer = pAllocated;
-    allocation.size = size;
-    allocation.isLive = true;
-    allocation.allocStackTraceFrames = Debug::CollectStackTrace(allocation.allocStackTrace, 100, 2);
-    pMemTrack->allocationTable[pAllocated] = allocation;
+    allocation.pointer = pEvent->pAllocated;
+    allocation.size = pEvent->size;
+    allocation.estimatedSize = EstimateSize(pEvent->size);
+    allocation.allocTrace = trace;
+    pMemTrack->allocationTable[pEvent->pAllocated] = allocation;
 }
 
 // ***********************************************************************
 
-void CheckRealloc(void* pAllocated, void* ptr, u64 size, u64 oldSize) {
-    if (pMemTrack == nullptr)
-        InitContext();
+void ApplyRealloc(TrackerEvent* pEvent, u32 trace) {
+    void* ptr = pEvent->ptr;
+    Allocation* alloc = ptr ? pMemTrack->allocationTable.Get(ptr) : nullptr;
+    if (alloc && alloc->pointer == pEvent->pAllocated) {  // grew or shrank in place
+        alloc->size = pEvent->size;
+        alloc->estimatedSize = EstimateSize(pEvent->size);
+        return;
+    }
 
-    if (Allocation* alloc = pMemTrack->allocationTable.Get(ptr)) {  // pre-existing allocation
-        if (alloc->pointer != pAllocated) {  // Memory has changed location, so we must change the key
-            // old alloc is effectively freed
-            alloc->isLive = false;
-            alloc->freeStackTraceFrames = Debug::CollectStackTrace(alloc->freeStackTrace, 100, 2);
-
-            Allocation newAlloc;
-            newAlloc.pointer = pAllocated;
-            newAlloc.size = size;
-            newAlloc.isLive = true;
-            newAlloc.allocStackTraceFrames = Debug::CollectStackTrace(newAlloc.allocStackTrace, 100, 2);
-            pMemTrack->allocationTable[pAllocated] = newAlloc;
-        } else {
-            alloc->size = size;
-        }
-    } else {  // new allocation
-        Allocation allocation;
-        allocation.pointer = pAllocated;
-        allocation.size = size;
-        allocation.isLive = true;
-        allocation.allocStackTraceFrames = Debug::CollectStackTrace(allocation.allocStackTrace, 100);
-        pMemTrack->allocationTable[pAllocated] = allocation;
+    if (g_sampleRate > 0) {
+        // A realloc that moves is a free of the old record and a fresh sampling decision for the new one,
+        // which the allocating thread already made
+        if (alloc)
+            pMemTrack->allocationTable.Erase(ptr);
+        if (pEvent->type == TE_REALLOC)
+            ApplyMalloc(pEvent, trace);
+        return;
     }
+
+    if (alloc) {  // Memory has changed location, the old block is effectively freed
+        RecordFree(*alloc, trace);
+        pMemTrack->allocationTable.Erase(ptr);
+    }
+    ApplyMalloc(pEvent, trace);
 }
 
 // ***********************************************************************
 
-void ReportDoubleFree(Allocation& alloc, void** newFreeTrace, u64 newFreeTraceFrames) {
-    String allocTrace = Debug::PrintStackTraceToString(alloc.allocStackTrace, alloc.allocStackTraceFrames, pMemTrack->pArena);
-    String trace = Debug::PrintStackTraceToString(alloc.freeStackTrace, alloc.freeStackTraceFrames, pMemTrack->pArena);
-    String trace2 = Debug::PrintStackTraceToString(newFreeTrace, newFreeTraceFrames, pMemTrack->pArena);
+void ReportDoubleFree(FreedAllocation& freed, u32 newFreeTrace) {
+    ScratchScope(scratch, nullptr);
+    String allocTrace = PrintTrace(freed.allocTrace, scratch.pArena);
+    String trace = PrintTrace(freed.freeTrace, scratch.pArena);
+    String trace2 = PrintTrace(newFreeTrace, scratch.pArena);
 
-    Log::Warn("------ Hey idiot, detected double free at %p. Fix your shit! ------\nAllocated At:\n%s\nPreviously Freed At: \n%s\nFreed Again At:\n%s", alloc.pointer, allocTrace.pData, trace.pData, trace2.pData);
-    __debugbreak();
+    Log::Warn("------ Hey idiot, detected double free at %p. Fix your shit! ------\nAllocated At:\n%s\nPreviously Freed At: \n%s\nFreed Again At:\n%s", freed.pointer, allocTrace.pData, trace.pData, trace2.pData);
+    DEBUG_BREAK();
 }
 
 // ***********************************************************************
 
 void ReportUnknownFree(void* ptr) {
     Log::Warn("\n------ Hey idiot, detected free of untracked memory %p. Fix your shit! ------\n", ptr);
-    __debugbreak();
+    DEBUG_BREAK();
 }
 
 // ***********************************************************************
 
-void CheckFree(void* ptr) {
+void ApplyFree(TrackerEvent* pEvent, u32 trace) {
+    void* ptr = pEvent->ptr;
+    if (g_sampleRate > 0) {
+        // most frees are of allocations we never sampled, so there's nothing to check
+        pMemTrack->allocationTable.Erase(ptr);
+        return;
+    }
+
+    if (Allocation* alloc = pMemTrack->allocationTable.Get(ptr)) {
+        RecordFree(*alloc, trace);
+        pMemTrack->allocationTable.Erase(ptr);
+        return;
+    }
+
+    // Not live, if we freed it recently this is a double free
+    i64 historyCount = pMemTrack->freedCount < FREED_HISTORY_SIZE ? pMemTrack->freedCount : FREED_HISTORY_SIZE;
+    for (i64 i = 1; i <= historyCount; i++) {
+        FreedAllocation& freed = pMemTrack->freedHistory[(pMemTrack->freedCount - i) % FREED_HISTORY_SIZE];
+        if (freed.pointer == ptr) {
+            ReportDoubleFree(freed, trace);
+            return;
+        }
+    }
+    ReportUnknownFree(ptr);
+}
+
+// ***********************************************************************
+
+void TrackerMerge() {
+    // Everything sequenced up to here gets merged, anything later waits for the next merge. The thread list
+    // is loaded after the sequence, so any thread that took one of these sequence numbers is in it
+    i64 cutoff = AtomicLoad(&g_trackerSequence) + 1;
+    TrackerThread* pThreads = (TrackerThread*)AtomicLoad((volatile i64*)&g_pTrackerThreads);
+    if (pThreads == nullptr)
+        return;
+
     if (pMemTrack == nullptr)
         InitContext();
 
-    if (Allocation* alloc = pMemTrack->allocationTable.Get(ptr)) {
-        if (!alloc->isLive) {
-            void* stackTrace[100];
-            u64 stackFrames = Debug::CollectStackTrace(stackTrace, 100);
-            ReportDoubleFree(*alloc, stackTrace, stackFrames);
+    // Wait out writers that are mid way through an event we need, they never block so this is short
+    for (TrackerThread* pThread = pThreads; pThread; pThread = pThread->pNext) {
+        i64 inFlight = AtomicLoad(&pThread->inFlight);
+        while (inFlight == -1 || (inFlight > 0 && inFlight < cutoff)) {
+            CpuRelax();
+            inFlight = AtomicLoad(&pThread->inFlight);
+        }
+    }
+
+    // Each thread's buffer is in sequence order, so merging them by sequence replays the allocations in the
+    // order they really happened. That matters when one thread frees an address another then reuses
+    while (true) {
+        TrackerThread* pOldestThread = nullptr;
+        TrackerEvent* pOldest = nullptr;
+        for (TrackerThread* pThread = pThreads; pThread; pThread = pThread->pNext) {
+            TrackerEvent* pEvent = TrackerPeekEvent(pThread);
+            if (pEvent && pEvent->sequence < cutoff && (pOldest == nullptr || pEvent->sequence < pOldest->sequence)) {
+                pOldest = pEvent;
+                pOldestThread = pThread;
+            }
         }
+        if (pOldest == nullptr)
+            break;
 
-        alloc->isLive = false;
-        alloc->freeStackTraceFrames = Debug::CollectStackTrace(alloc->freeStackTrace, 100);
-    } else {
-        ReportUnknownFree(ptr);
+        u32 trace = InternStackTrace((void**)(pOldest + 1), pOldest->frameCount);
+        switch (pOldest->type) {
+            case TE_MALLOC: ApplyMalloc(pOldest, trace); break;
+            case TE_REALLOC:
+            case TE_REALLOC_UNSAMPLED: ApplyRealloc(pOldest, trace); break;
+            case TE_FREE: ApplyFree(pOldest, trace); break;
+            case TE_NOT_A_LEAK:
+                if (Allocation* alloc = pMemTrack->allocationTable.Get(pOldest->ptr))
+                    alloc->notALeak = true;
+                break;
+        }
+        pOldestThread->readOffset += sizeof(TrackerEvent) + pOldest->frameCount * sizeof(void*);
+    }
+
+    // Exited threads won't record anything else, once everything they did record is merged they can go. New threads
+    // are only ever pushed on the front, so anything further in can be unlinked with a plain store
+    TrackerThread* pPrev = nullptr;
+    TrackerThread* pThread = (TrackerThread*)AtomicLoad((volatile i64*)&g_pTrackerThreads);
+    while (pThread) {
+        TrackerThread* pNext = pThread->pNext;
+        if (!AtomicLoad(&pThread->exited) || TrackerPeekEvent(pThread) != nullptr) {
+            pPrev = pThread;
+            pThread = pNext;
+            continue;
+        }
+
+        if (pPrev == nullptr && !AtomicCompareExchange((volatile i64*)&g_pTrackerThreads, (i64)pThread, (i64)pNext)) {
+            // someone registered in front of us meanwhile
+            pPrev = (TrackerThread*)AtomicLoad((volatile i64*)&g_pTrackerThreads);
+            while (pPrev->pNext != pThread)
+                pPrev = pPrev->pNext;
+        }
+        if (pPrev)
+            pPrev->pNext = pNext;
+        VirtualRelease((u8*)pThread->pReadBlock, TRACKER_BLOCK_SIZE);
+        VirtualRelease((u8*)pThread, VirtualPageSize());
+        pThread = pNext;
     }
 }
 
 // ***********************************************************************
 
-void MarkNotALeak(void* ptr) {
-	if (pMemTrack == nullptr)
-		InitContext();
+void FlushMemoryTracking() {
+    SpinLockAcquire(g_trackerMergeLock);
+    TrackerMerge();
+    SpinLockRelease(g_trackerMergeLock);
+}
 
-	if (Allocation* alloc = pMemTrack->allocationTable.Get(ptr)) {
-		alloc->notALeak = true;
-	}
+// ***********************************************************************
+
+void MemoryTrackingThreadRelease() {
+    if (t_pTrackerThread == nullptr)
+        return;
+
+    // Everything this thread recorded is already committed, the next merge frees it after replaying them
+    AtomicStore(&t_pTrackerThread->exited, 1);
+    t_pTrackerThread = nullptr;
 }
 
 // ***********************************************************************
 
+void RecordTrackerEvent(TrackerEventType type, void* pAllocated, void* ptr, u64 size, bool captureTrace) {
+    TrackerThread* pThread = t_pTrackerThread ? t_pTrackerThread : TrackerRegisterThread();
+
+    u64 maxEventSize = sizeof(TrackerEvent) + (captureTrace ? MAX_TRACE_FRAMES * sizeof(void*) : 0);
+    if (pThread->writeOffset + maxEventSize > TRACKER_BLOCK_SIZE - sizeof(TrackerEventBlock)) {
+        TrackerEventBlock* pBlock = TrackerNewBlock();
+        AtomicStore((volatile i64*)&pThread->pWriteBlock->pNext, (i64)pBlock);
+        pThread->pWriteBlock = pBlock;
+        pThread->writeOffset = 0;
+
+        // Merge now and then so buffers don't pile up between reports, but never wait on someone else's merge
+        if (SpinLockTryAcquire(g_trackerMergeLock)) {
+            TrackerMerge();
+            SpinLockRelease(g_trackerMergeLock);
+        }
+    }
+
+    // -1 covers the gap between taking a sequence number and publishing it, so a merge can't miss us
+    AtomicStore(&pThread->inFlight, -1);
+    TrackerEvent* pEvent = (TrackerEvent*)(pThread->pWriteBlock->data + pThread->writeOffset);
+    pEvent->sequence = AtomicAdd(&g_trackerSequence, 1) + 1;
+    AtomicStore(&pThread->inFlight, pEvent->sequence);
+
+    pEvent->type = type;
+    pEvent->pAllocated = pAllocated;
+    pEvent->ptr = ptr;
+    pEvent->size = size;
+    pEvent->frameCount = captureTrace ? (u32)Debug::CollectStackTrace((void**)(pEvent + 1), MAX_TRACE_FRAMES, 3) : 0;
+
+    pThread->writeOffset += sizeof(TrackerEvent) + pEvent->frameCount * sizeof(void*);
+    AtomicStore(&pThread->pWriteBlock->committed, pThread->writeOffset);
+    AtomicStore(&pThread->inFlight, 0);
+}
+
+// ***********************************************************************
+
+void CheckMalloc(void* pAllocated, u64 size) {
+    if (!ShouldSample(size))
+        return;
+    RecordTrackerEvent(TE_MALLOC, pAllocated, nullptr, size, true);
+}
+
+// ***********************************************************************
+
+void CheckRealloc(void* pAllocated, void* ptr, u64 size, u64 oldSize) {
+    // Whether the new block gets a record is decided here, the sampler is per thread
+    bool sampled = ShouldSample(size);
+    RecordTrackerEvent(sampled ? TE_REALLOC : TE_REALLOC_UNSAMPLED, pAllocated, ptr, size, sampled);
+}
+
+// ***********************************************************************
+
+void CheckFree(void* ptr) {
+    RecordTrackerEvent(TE_FREE, nullptr, ptr, 0, g_sampleRate <= 0);
+}
+
+// ***********************************************************************
+
+void MarkNotALeak(void* ptr) {
+    RecordTrackerEvent(TE_NOT_A_LEAK, nullptr, ptr, 0, false);
+}
+
+// ***********************************************************************
+
+struct LeakGroup {
+    u32 allocTrace;
+    i64 count;
+    i64 bytes;
+    void* pFirstAddress;
+};
+
+struct LeakGroupBiggestFirst {
+    bool operator()(const LeakGroup& a, const LeakGroup& b) {
+        return a.bytes < b.bytes;
+    }
+};
+
 int ReportMemoryLeaks() {
 #ifdef MEMORY_TRACKING
-    if (pMemTrack == nullptr)
+    // Hold the merge lock throughout so no one merges into the table while we walk it
+    SpinLockAcquire(g_trackerMergeLock);
+    TrackerMerge();
+    if (pMemTrack == nullptr) {
+        SpinLockRelease(g_trackerMergeLock);
         return 0;
+    }
+
+    // Leaks from the same callsite share a trace, so we report each callsite once, biggest first
+    ScratchScope(scratch, nullptr);
+    HashMap<u32, i64> groupIndices(scratch.pArena);
+    ResizableArray<LeakGroup> groups(scratch.pArena);
 
     int leakCounter = 0;
-    for (i64 i = 0; i < pMemTrack->allocationTable.tableSize; i++) {
-        if (pMemTrack->allocationTable.pTable[i].hash != UNUSED_HASH) {
-            Allocation& alloc = pMemTrack->allocationTable.pTable[i].value;
-            if (alloc.isLive && !alloc.notALeak) {
-                leakCounter++;
-                String trace = Debug::PrintStackTraceToString(alloc.allocStackTrace, alloc.allocStackTraceFrames, pMemTrack->pArena);
-                Log::Warn(" ------ Oi dimwit, detected memory leak at address %p of size %zi. Fix your shit! ------\n%s", alloc.pointer, alloc.size, trace.pData);
+    for (HashNode<void*, Allocation>& node : pMemTrack->allocationTable) {
+        Allocation& alloc = node.value;
+        if (!alloc.notALeak) {
+            leakCounter++;
+            i64* pIndex = groupIndices.Get(alloc.allocTrace);
+            if (pIndex == nullptr) {
+                LeakGroup group = { alloc.allocTrace, 0, 0, alloc.pointer };
+                groupIndices.Add(alloc.allocTrace, groups.count);
+                groups.PushBack(group);
+                pIndex = groupIndices.Get(alloc.allocTrace);
             }
+            groups[*pIndex].count++;
+            groups[*pIndex].bytes += alloc.estimatedSize;
         }
     }
+
+    if (groups.count > 0)
+        Sort(groups.pData, groups.count, LeakGroupBiggestFirst());
+
+    // Symbolize every frame in one go up front, rather than stalling on the symbolizer once per trace
+    for (i64 i = 0; i < groups.count; i++) {
+        StackTrace& trace = pMemTrack->traces[groups[i].allocTrace];
+        Debug::SymbolizeStackFrames(trace.pFrames, trace.frameCount);
+    }
+    for (i64 i = 0; i < groups.count; i++) {
+        LeakGroup& group = groups[i];
+        String trace = PrintTrace(group.allocTrace, scratch.pArena);
+        if (group.count == 1)
+            Log::Warn(" ------ Oi dimwit, detected memory leak at address %p of size %lli. Fix your shit! ------\n%s", group.pFirstAddress, group.bytes, trace.pData);
+        else
+            Log::Warn(" ------ Oi dimwit, detected %lli memory leaks totalling %lli bytes from one callsite (first at %p). Fix your shit! ------\n%s", group.count, group.bytes, group.pFirstAddress, trace.pData);
+    }
+    SpinLockRelease(g_trackerMergeLock);
     return leakCounter;
 #else
     return 0;
@@ -147,20 +565,272 @@ int ReportMemoryLeaks() {
 
 // ***********************************************************************
 
-void ReportMemoryUsage() {
-#ifdef MEMORY_TRACKING
-    if (pMemTrack == nullptr)
-        return;
+i64 GetTrackedMemoryUsage() {
+    SpinLockAcquire(g_trackerMergeLock);
+    TrackerMerge();
 
 	i64 memoryAllocated = 0;
-    for (i64 i = 0; i < pMemTrack->allocationTable.tableSize; i++) {
-        if (pMemTrack->allocationTable.pTable[i].hash != UNUSED_HASH) {
-            Allocation& alloc = pMemTrack->allocationTable.pTable[i].value;
-			if (alloc.isLive) {
-				memoryAllocated += alloc.size;
-			}
-		}
-	}
-	Log::Info("Tracked memory usage: %d (bytes) %f (kbytes) %f (mbytes)", memoryAllocated, (f32)memoryAllocated/1024, (f32)memoryAllocated/1024/1024);
+    if (pMemTrack) {
+        for (HashNode<void*, Allocation>& node : pMemTrack->allocationTable) {
+            memoryAllocated += node.value.estimatedSize;
+        }
+    }
+    SpinLockRelease(g_trackerMergeLock);
+	return memoryAllocated;
+}
+
+// ***********************************************************************
+
+void ReportMemoryUsage() {
+#ifdef MEMORY_TRACKING
+	i64 memoryAllocated = GetTrackedMemoryUsage();
+	if (g_sampleRate > 0)
+		Log::Info("Estimated memory usage (sampling every %lli bytes): %lli (bytes) %f (kbytes) %f (mbytes)", g_sampleRate, memoryAllocated, (f32)memoryAllocated/1024, (f32)memoryAllocated/1024/1024);
+	else
+		Log::Info("Tracked memory usage: %lli (bytes) %f (kbytes) %f (mbytes)", memoryAllocated, (f32)memoryAllocated/1024, (f32)memoryAllocated/1024/1024);
 #endif
 }
+
+// ***********************************************************************
+
+struct HeapProfileEntryBiggestFirst {
+    bool operator()(const HeapProfileEntry& a, const HeapProfileEntry& b) {
+        return a.bytes < b.bytes;
+    }
+};
+
+HeapProfile TakeHeapProfile(Arena* pArena) {
+    HeapProfile profile;
+    profile.entries = ResizableArray<HeapProfileEntry>(pArena);
+    profile.totalCount = 0;
+    profile.totalBytes = 0;
+
+    SpinLockAcquire(g_trackerMergeLock);
+    TrackerMerge();
+    if (pMemTrack) {
+        ScratchScope(scratch, pArena);
+        HashMap<u32, i64> entryIndices(scratch.pArena);
+        for (HashNode<void*, Allocation>& node : pMemTrack->allocationTable) {
+            Allocation& alloc = node.value;
+            i64* pIndex = entryIndices.Get(alloc.allocTrace);
+            if (pIndex == nullptr) {
+                HeapProfileEntry entry = { alloc.allocTrace, 0, 0 };
+                entryIndices.Add(alloc.allocTrace, profile.entries.count);
+                profile.entries.PushBack(entry);
+                pIndex = entryIndices.Get(alloc.allocTrace);
+            }
+
+            // a sampled record stands in for estimatedSize / size allocations like it
+            i64 count = alloc.size > 0 ? alloc.estimatedSize / alloc.size : 1;
+            profile.entries[*pIndex].count += count;
+            profile.entries[*pIndex].bytes += alloc.estimatedSize;
+            profile.totalCount += count;
+            profile.totalBytes += alloc.estimatedSize;
+        }
+    }
+    SpinLockRelease(g_trackerMergeLock);
+
+    if (profile.entries.count > 0)
+        Sort(profile.entries.pData, profile.entries.count, HeapProfileEntryBiggestFirst());
+    return profile;
+}
+
+// ***********************************************************************
+
+HeapProfile DiffHeapProfiles(HeapProfile& before, HeapProfile& after, Arena* pArena) {
+    HeapProfile diff;
+    diff.entries = ResizableArray<HeapProfileEntry>(pArena);
+    diff.totalCount = after.totalCount - before.totalCount;
+    diff.totalBytes = after.totalBytes - before.totalBytes;
+
+    ScratchScope(scratch, pArena);
+    HashMap<u32, i64> entryIndices(scratch.pArena);
+    for (i64 i = 0; i < after.entries.count; i++) {
+        entryIndices.Add(after.entries[i].trace, diff.entries.count);
+        diff.entries.PushBack(after.entries[i]);
+    }
+    for (i64 i = 0; i < before.entries.count; i++) {
+        HeapProfileEntry& entry = before.entries[i];
+        if (i64* pIndex = entryIndices.Get(entry.trace)) {
+            diff.entries[*pIndex].count -= entry.count;
+            diff.entries[*pIndex].bytes -= entry.bytes;
+        } else {
+            HeapProfileEntry shrunk = { entry.trace, -entry.count, -entry.bytes };
+            diff.entries.PushBack(shrunk);
+        }
+    }
+
+    // drop the callsites that didn't change
+    for (i64 i = diff.entries.count - 1; i >= 0; i--) {
+        if (diff.entries[i].count == 0 && diff.entries[i].bytes == 0)
+            diff.entries.EraseUnsorted(i);
+    }
+    if (diff.entries.count > 0)
+        Sort(diff.entries.pData, diff.entries.count, HeapProfileEntryBiggestFirst());
+    return diff;
+}
+
+// ***********************************************************************
+
+String HeapProfileToCollapsedStacks(HeapProfile& profile, Arena* pArena) {
+    ScratchScope(scratch, pArena);
+    HashMap<void*, String> symbols(scratch.pArena);
+    StringBuilder builder(scratch.pArena);
+
+    SpinLockAcquire(g_trackerMergeLock);
+    for (i64 i = 0; i < profile.entries.count; i++) {
+        HeapProfileEntry& entry = profile.entries[i];
+        if (entry.bytes <= 0) // flamegraphs can't show shrinkage
+            continue;
+
+        // frames are leaf first, collapsed stacks want the root first
+        StackTrace& trace = pMemTrack->traces[entry.trace];
+        for (i64 j = i64(trace.frameCount) - 1; j >= 0; j--) {
+            String* pName = symbols.Get(trace.pFrames[j]);
+            if (pName == nullptr) {
+                symbols.Add(trace.pFrames[j], Debug::SymbolizeAddress(trace.pFrames[j], scratch.pArena));
+                pName = symbols.Get(trace.pFrames[j]);
+            }
+            builder.Append(*pName);
+            if (j > 0)
+                builder.Append(";");
+        }
+        if (trace.frameCount == 0)
+            builder.Append("[unknown]");
+        builder.AppendFormat(" %lli\n", entry.bytes);
+    }
+    SpinLockRelease(g_trackerMergeLock);
+    return builder.CreateString(pArena);
+}
+
+// ***********************************************************************
+
+// Just enough protobuf encoding for profile.proto, it's all varints and length delimited messages
+
+void PbVarint(StringBuilder& out, u64 value) {
+    char bytes[10];
+    u64 length = 0;
+    do {
+        bytes[length] = char(value & 0x7f);
+        value >>= 7;
+        if (value)
+            bytes[length] |= 0x80;
+        length++;
+    } while (value);
+    out.AppendChars(bytes, length);
+}
+
+void PbInt(StringBuilder& out, u64 field, u64 value) {
+    PbVarint(out, field << 3);
+    PbVarint(out, value);
+}
+
+void PbBytes(StringBuilder& out, u64 field, const char* pData, u64 length) {
+    PbVarint(out, (field << 3) | 2);
+    PbVarint(out, length);
+    out.AppendChars(pData, length);
+}
+
+void PbMessage(StringBuilder& out, u64 field, StringBuilder& message) {
+    PbBytes(out, field, message.pData, message.length);
+    message.length = 0;
+}
+
+// ***********************************************************************
+
+String HeapProfileToPprof(HeapProfile& profile, Arena* pArena) {
+    ScratchScope(scratch, pArena);
+    StringBuilder out(scratch.pArena);
+    StringBuilder message(scratch.pArena);
+    StringBuilder packed(scratch.pArena);
+    ResizableArray<String> strings(scratch.pArena);
+
+    // string table, 0 has to be the empty string
+    const char* fixedStrings[] = { "", "inuse_objects", "count", "inuse_space", "bytes", "space" };
+    for (const char* str : fixedStrings)
+        strings.PushBack(String(str));
+
+    // sample_type (1), one value type per sample value
+    PbInt(message, 1, 1); PbInt(message, 2, 2);
+    PbMessage(out, 1, message);
+    PbInt(message, 1, 3); PbInt(message, 2, 4);
+    PbMessage(out, 1, message);
+
+    // Every distinct frame address becomes one location and one function with the same id
+    HashMap<void*, u64> locationIds(scratch.pArena);
+    ResizableArray<void*> locations(scratch.pArena);
+
+    SpinLockAcquire(g_trackerMergeLock);
+    for (i64 i = 0; i < profile.entries.count; i++) {
+        HeapProfileEntry& entry = profile.entries[i];
+        StackTrace& trace = pMemTrack->traces[entry.trace];
+
+        // sample (2), location ids are leaf first, as are our frames
+        for (u64 j = 0; j < trace.frameCount; j++) {
+            u64* pId = locationIds.Get(trace.pFrames[j]);
+            if (pId == nullptr) {
+                locations.PushBack(trace.pFrames[j]);
+                locationIds.Add(trace.pFrames[j], locations.count);
+                pId = locationIds.Get(trace.pFrames[j]);
+            }
+            PbVarint(packed, *pId);
+        }
+        PbBytes(message, 1, packed.pData, packed.length);
+        packed.length = 0;
+        PbVarint(packed, u64(entry.count));
+        PbVarint(packed, u64(entry.bytes));
+        PbBytes(message, 2, packed.pData, packed.length);
+        packed.length = 0;
+        PbMessage(out, 2, message);
+    }
+    SpinLockRelease(g_trackerMergeLock);
+
+    StringBuilder line(scratch.pArena);
+    for (i64 i = 0; i < locations.count; i++) {
+        u64 id = u64(i + 1);
+
+        // location (4) with a single line (4) pointing at its function
+        PbInt(message, 1, id);
+        PbInt(message, 3, u64(uintptr_t(locations[i])));
+        PbInt(line, 1, id);
+        PbMessage(message, 4, line);
+        PbMessage(out, 4, message);
+
+        // function (5), name and system_name
+        PbInt(message, 1, id);
+        PbInt(message, 2, u64(strings.count));
+        PbInt(message, 3, u64(strings.count));
+        PbMessage(out, 5, message);
+        strings.PushBack(Debug::SymbolizeAddress(locations[i], scratch.pArena));
+    }
+
+    // string_table (6)
+    for (i64 i = 0; i < strings.count; i++)
+        PbBytes(out, 6, strings[i].pData, strings[i].length);
+
+    // period_type (11), period (12) and default_sample_type (14)
+    PbInt(message, 1, 5); PbInt(message, 2, 4);
+    PbMessage(out, 11, message);
+    PbInt(out, 12, g_sampleRate > 0 ? u64(g_sampleRate) : 1);
+    PbInt(out, 14, 3);
+
+    return out.CreateString(pArena);
+}
+
+// ***********************************************************************
+
+void ReportHeapGrowth(HeapProfile& before, HeapProfile& after, i64 maxCallsites) {
+    ScratchScope(scratch, nullptr);
+    HeapProfile diff = DiffHeapProfiles(before, after, scratch.pArena);
+    Log::Info("Heap grew by %lli bytes in %lli allocations", diff.totalBytes, diff.totalCount);
+
+    SpinLockAcquire(g_trackerMergeLock);
+    for (i64 i = 0; i < diff.entries.count && i < maxCallsites; i++) {
+        HeapProfileEntry& entry = diff.entries[i];
+        if (entry.bytes <= 0)
+            break;
+        String trace = PrintTrace(entry.trace, scratch.pArena);
+        Log::Info(" +%lli bytes in %lli allocations from:\n%s", entry.bytes, entry.count, trace.pData);
+    }
+    SpinLockRelease(g_trackerMergeLock);
+}
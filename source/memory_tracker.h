@@ -13,3 +13,38 @@ void CheckFree(void* ptr);
 void MarkNotALeak(void* ptr);
 int ReportMemoryLeaks();
 void ReportMemoryUsage();
+
+// Allocation events are buffered per thread and merged into the tracker lazily. Reports and usage queries flush
+// on their own, call this if you want double/unknown free reports to come out sooner
+void FlushMemoryTracking();
+void MemoryTrackingThreadRelease(); // call before a thread exits if it allocated, its buffers are freed by the next flush
+
+// Sampling mode, instead of recording every allocation we record on average one per this many bytes allocated
+// (Poisson sampled per byte like tcmalloc does). Each sampled record is weighted so that usage totals are unbiased
+// estimates of the real numbers. Double free and unknown free detection only work when tracking everything
+#ifndef MEMORY_TRACKING_SAMPLE_RATE
+#define MEMORY_TRACKING_SAMPLE_RATE 0 // 0 means track every allocation
+#endif
+
+void SetMemoryTrackingSampleRate(i64 meanBytesBetweenSamples);
+i64 GetTrackedMemoryUsage(); // estimated bytes live, exact when not sampling
+
+// Heap profiles, live allocations totalled up by the callsite that made them. Take one now and then and diff
+// them to see what's growing, or export them for flamegraph.pl/speedscope (collapsed stacks) or pprof
+struct HeapProfileEntry {
+    u32 trace;  // interned callsite
+    i64 count;
+    i64 bytes;
+};
+
+struct HeapProfile {
+    ResizableArray<HeapProfileEntry> entries; // biggest first
+    i64 totalCount;
+    i64 totalBytes;
+};
+
+HeapProfile TakeHeapProfile(Arena* pArena);
+HeapProfile DiffHeapProfiles(HeapProfile& before, HeapProfile& after, Arena* pArena); // after minus before, per callsite
+String HeapProfileToCollapsedStacks(HeapProfile& profile, Arena* pArena); // "root;...;leaf bytes" per line, growth only
+String HeapProfileToPprof(HeapProfile& profile, Arena* pArena); // uncompressed profile.proto, pprof reads it as is
+void ReportHeapGrowth(HeapProfile& before, HeapProfile& after, i64 maxCallsites = 10);
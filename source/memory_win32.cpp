@@ -0,0 +1,56 @@
+// Copyright 2020-2022 David Colson. All rights reserved.
+
+#ifdef _WIN32
+
+// ***********************************************************************
+
+i64 VirtualPageSize() {
+	static i64 pageSize = 0;
+	if (pageSize == 0) {
+		SYSTEM_INFO sysInfo;
+		GetSystemInfo(&sysInfo);
+		pageSize = sysInfo.dwPageSize;
+	}
+	return pageSize;
+}
+
+// ***********************************************************************
+
+i64 VirtualHugePageSize() {
+	// Large pages on windows need SeLockMemoryPrivilege and must be committed in full when reserved,
+	// which defeats the point of an arena, so we just stick to normal pages here
+	return VirtualPageSize();
+}
+
+// ***********************************************************************
+
+u8* VirtualReserve(i64 size, u32 flags) {
+	return (u8*)VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_READWRITE);
+}
+
+// ***********************************************************************
+
+bool VirtualCommit(u8* pAddress, i64 size) {
+	return VirtualAlloc(pAddress, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+// ***********************************************************************
+
+void VirtualDecommit(u8* pAddress, i64 size) {
+	VirtualFree(pAddress, size, MEM_DECOMMIT);
+}
+
+// ***********************************************************************
+
+void VirtualRelease(u8* pAddress, i64 size) {
+	VirtualFree(pAddress, 0, MEM_RELEASE);
+}
+
+// ***********************************************************************
+
+u8* VirtualRemap(u8* pAddress, i64 oldSize, i64 newSize) {
+	// No equivalent of mremap without AWE, callers fall back to reserving ahead and copying
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,185 @@
+// Copyright 2020-2022 David Colson. All rights reserved.
+
+#pragma once
+
+// Slab Allocator
+// -----------------------
+// Hands out fixed size slots carved out of blocks allocated from an arena. Freed slots go onto an
+// intrusive free list and get reused first, so churning objects never grows the arena beyond the peak
+// live count. Reset returns every slot at once while keeping the blocks for reuse.
+// Memory is only really released when the arena is reset or finished
+
+struct SlabFreeSlot {
+    SlabFreeSlot* pNext;
+};
+
+struct SlabBlock {
+    SlabBlock* pNext;
+};
+
+struct SlabAllocator {
+    Arena* pArena{nullptr};
+    i64 slotSize{0};
+    i64 slotAlign{0};
+    i64 slotsPerBlock{0};
+    i64 count{0};
+
+    SlabFreeSlot* pFreeList{nullptr};
+    SlabBlock* pFirstBlock{nullptr};
+    SlabBlock* pCurrentBlock{nullptr};
+    u8* pBumpCursor{nullptr};
+    u8* pBumpEnd{nullptr};
+
+    SlabAllocator(Arena* _pArena = nullptr, i64 _slotSize = 0, i64 _slotAlign = 0, i64 _slotsPerBlock = 64);
+
+    void* Alloc(bool uninitialized = false);
+
+    void Free(void* ptr);
+
+    void Reset();
+
+    i64 BlockSize() const;
+
+    u8* BlockSlots(SlabBlock* pBlock) const;
+};
+
+// Pool
+// -----------------------
+// Typed wrapper over the slab allocator. As everywhere else in this library, no constructors or
+// destructors are run, you get zeroed (or uninitialized) memory
+
+template<typename T>
+struct Pool {
+    SlabAllocator slab;
+
+    Pool(Arena* pArena = nullptr, i64 slotsPerBlock = 64);
+
+    T* Alloc(bool uninitialized = false);
+
+    void Free(T* ptr);
+
+    void Reset();
+
+    i64 Count() const;
+};
+
+
+
+// IMPLEMENTATION
+
+// ***********************************************************************
+
+inline SlabAllocator::SlabAllocator(Arena* _pArena, i64 _slotSize, i64 _slotAlign, i64 _slotsPerBlock) {
+    pArena = _pArena;
+    // every slot must be able to hold a free list link when it's not in use
+    slotAlign = _slotAlign > (i64)alignof(SlabFreeSlot) ? _slotAlign : (i64)alignof(SlabFreeSlot);
+    slotSize = Align(_slotSize > (i64)sizeof(SlabFreeSlot) ? _slotSize : (i64)sizeof(SlabFreeSlot), slotAlign);
+    slotsPerBlock = _slotsPerBlock;
+}
+
+// ***********************************************************************
+
+inline i64 SlabAllocator::BlockSize() const {
+    return Align(sizeof(SlabBlock), slotAlign) + slotSize * slotsPerBlock;
+}
+
+// ***********************************************************************
+
+inline u8* SlabAllocator::BlockSlots(SlabBlock* pBlock) const {
+    return AlignPtr((u8*)pBlock + sizeof(SlabBlock), slotAlign);
+}
+
+// ***********************************************************************
+
+inline void* SlabAllocator::Alloc(bool uninitialized) {
+    void* pSlot = nullptr;
+    if (pFreeList) {
+        pSlot = pFreeList;
+        pFreeList = pFreeList->pNext;
+    } else {
+        if (pBumpCursor == pBumpEnd) {
+            // Move onto the next block, reusing blocks from before a reset if we have them
+            SlabBlock* pNextBlock = pCurrentBlock ? pCurrentBlock->pNext : pFirstBlock;
+            if (pNextBlock == nullptr) {
+                Assert(pArena);
+                pNextBlock = (SlabBlock*)ArenaAlloc(pArena, BlockSize(), slotAlign > (i64)alignof(SlabBlock) ? slotAlign : alignof(SlabBlock), true);
+                pNextBlock->pNext = nullptr;
+                if (pCurrentBlock)
+                    pCurrentBlock->pNext = pNextBlock;
+                else
+                    pFirstBlock = pNextBlock;
+            }
+            pCurrentBlock = pNextBlock;
+            pBumpCursor = BlockSlots(pCurrentBlock);
+            pBumpEnd = pBumpCursor + slotSize * slotsPerBlock;
+        }
+        pSlot = pBumpCursor;
+        pBumpCursor += slotSize;
+    }
+
+    count++;
+    if (!uninitialized)
+        memset(pSlot, 0, slotSize);
+    return pSlot;
+}
+
+// ***********************************************************************
+
+inline void SlabAllocator::Free(void* ptr) {
+    if (ptr == nullptr)
+        return;
+    Assert(count > 0);
+
+#ifdef STAMP_RESET_ARENAS
+    memset(ptr, 0xcc, slotSize);
+#endif
+
+    SlabFreeSlot* pSlot = (SlabFreeSlot*)ptr;
+    pSlot->pNext = pFreeList;
+    pFreeList = pSlot;
+    count--;
+}
+
+// ***********************************************************************
+
+inline void SlabAllocator::Reset() {
+    pFreeList = nullptr;
+    pCurrentBlock = nullptr;
+    pBumpCursor = nullptr;
+    pBumpEnd = nullptr;
+    count = 0;
+}
+
+// ***********************************************************************
+
+template<typename T>
+inline Pool<T>::Pool(Arena* pArena, i64 slotsPerBlock)
+    : slab(pArena, sizeof(T), alignof(T), slotsPerBlock) {}
+
+// ***********************************************************************
+
+template<typename T>
+inline T* Pool<T>::Alloc(bool uninitialized) {
+    return (T*)slab.Alloc(uninitialized);
+}
+
+// ***********************************************************************
+
+template<typename T>
+inline void Pool<T>::Free(T* ptr) {
+    slab.Free(ptr);
+}
+
+// ***********************************************************************
+
+template<typename T>
+inline void Pool<T>::Reset() {
+    slab.Reset();
+}
+
+// ***********************************************************************
+
+template<typename T>
+inline i64 Pool<T>::Count() const {
+    return slab.count;
+}
@@ -83,14 +83,14 @@ inline Quat<T> Quat<T>::Identity() {
 // ***********************************************************************
 
 template<typename T>
-inline static Quat<T> Quat<T>::MakeFromEuler(Vec3<T> v) {
+inline Quat<T> Quat<T>::MakeFromEuler(Vec3<T> v) {
     return MakeFromEuler(v.x, v.y, v.z);
 }
 
 // ***********************************************************************
 
 template<typename T>
-inline static Quat<T> Quat<T>::MakeFromEuler(T x, T y, T z) {
+inline Quat<T> Quat<T>::MakeFromEuler(T x, T y, T z) {
     // This is a body 3-2-1 (z, then y, then x) rotation
     const f32 cx = cosf(x * 0.5f);
     const f32 sx = sinf(x * 0.5f);
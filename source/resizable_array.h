@@ -120,7 +120,7 @@ void ResizableArray<Type>::EraseUnsorted(i64 index) {
     Assert(index >= 0 && index < count);
     if (index == count - 1) {
         PopBack();
-        count--;
+        return;
     }
     if (index < count - 1) {
         memcpy(pData + index, pData + (count - 1), sizeof(Type));
@@ -26,7 +26,9 @@ void Swap(Type& one, Type& two) {
 template<typename Type, typename Comparison = SortAscending<Type>>
 void QSortRecursive(Type* pData, i64 low, i64 high, Comparison cmp) {
     if (low < high) {
-        i64 pivot = low;  // TODO: Different pivot picking heuristic?
+        // Pivot on the middle element, picking the first one goes quadratic (and very deep) on already sorted data
+        Swap(pData[low], pData[low + (high - low) / 2]);
+        i64 pivot = low;
         i64 i = low;
         i64 j = high;
 
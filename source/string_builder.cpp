@@ -72,12 +72,19 @@ void StringBuilder::AppendFormatInternal(const char* format, va_list args) {
         }
 
 		const char* formatStart = format;
-		bool requiresCount = false;
+		i32 starCount = 0;
+		char size = 0; // 'H' hh, 'h', 'l', 'q' ll or I64, 'j', 'z', 't', 'L'
 		format++;
 		while (!IsFormatSpecifier(*format)) {
-			if (*(format++) == '*') {
-				requiresCount = true;
-			}
+			char c = *(format++);
+			if (c == '*')
+				starCount++;
+			else if (c == 'h' || c == 'l')
+				size = size == c ? (c == 'h' ? 'H' : 'q') : c;
+			else if (c == 'I')
+				size = 'q';
+			else if (c == 'j' || c == 'z' || c == 't' || c == 'L')
+				size = c;
 		}
 		if (*format == 'S') {
 			// special handling for our non-null terminated string
@@ -90,18 +97,49 @@ void StringBuilder::AppendFormatInternal(const char* format, va_list args) {
 		}
 		else {
 			// default handling for everything else
+			char conversion = *format;
 			format++;
 			memcpy(formatHelper, formatStart, format-formatStart);
 
 			// formatHelper now contains the format we want to process
-			i32 addedLength = vsnprintf(nullptr, 0, formatHelper, args);
+			// vsnprintf consumes whatever list it's given, so each call gets its own copy
+			va_list measureArgs;
+			va_copy(measureArgs, args);
+			i32 addedLength = vsnprintf(nullptr, 0, formatHelper, measureArgs);
+			va_end(measureArgs);
 			Reserve(GrowCapacity(length + addedLength + 1));
-			vsnprintf(pData + length, addedLength + 1, formatHelper, args);
+			va_list writeArgs;
+			va_copy(writeArgs, args);
+			vsnprintf(pData + length, addedLength + 1, formatHelper, writeArgs);
+			va_end(writeArgs);
 			length += addedLength;
 
-			va_arg(args, int); // skip element since the above copied the arg list
-			if (requiresCount)
+			// now step past what was used, with the real types, doubles and 64 bit values don't sit where an int does
+			for (i32 i = 0; i < starCount; i++)
 				va_arg(args, int);
+			switch (conversion) {
+				case '%':
+					break;
+				case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+					if (size == 'L')
+						va_arg(args, long double);
+					else
+						va_arg(args, double);
+					break;
+				case 's': case 'p': case 'n':
+					va_arg(args, void*);
+					break;
+				default:
+					switch (size) {
+						case 'l': va_arg(args, long); break;
+						case 'q': va_arg(args, long long); break;
+						case 'j': va_arg(args, intmax_t); break;
+						case 'z': va_arg(args, size_t); break;
+						case 't': va_arg(args, intptr_t); break;
+						default: va_arg(args, int); break;
+					}
+					break;
+			}
 
 			// reset format for next time
 			memset(formatHelper, 0, 256);
@@ -179,7 +217,8 @@ String StringPrint(Arena* pArena, const char* format, ...) {
     va_list args;
     va_start(args, format);
 	
-	StringBuilder builder(g_pArenaFrame);
+	ScratchScope(scratch, pArena);
+	StringBuilder builder(scratch.pArena);
 	builder.AppendFormatInternal(format, args);
 	String result = builder.CreateString(pArena);
 
@@ -193,7 +232,8 @@ String TempPrint(const char* format, ...) {
     va_list args;
     va_start(args, format);
 	
-	StringBuilder builder(g_pArenaFrame);
+	ScratchScope(scratch, g_pArenaFrame);
+	StringBuilder builder(scratch.pArena);
 	builder.AppendFormatInternal(format, args);
 	String result = builder.CreateString(g_pArenaFrame);
 
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <stdarg.h>
+
 // String Builder
 // ---------------------
 // A dynamic char buffer used to construct strings
@@ -10,7 +12,6 @@
 
 struct String;
 struct IAllocator;
-typedef char* va_list;
 
 struct StringBuilder {
     char* pData { nullptr };
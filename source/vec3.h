@@ -299,21 +299,21 @@ inline Vec3<T> Vec3<T>::operator-() const {
 // ***********************************************************************
 
 template<typename T>
-inline static Vec3<T> Vec3<T>::CompMul(const Vec3& lhs, const Vec3& rhs) {
+inline Vec3<T> Vec3<T>::CompMul(const Vec3& lhs, const Vec3& rhs) {
     return Vec3(lhs.x * rhs.x, lhs.y * rhs.y, lhs.z * rhs.z);
 }
 
 // ***********************************************************************
 
 template<typename T>
-inline static Vec3<T> Vec3<T>::CompDiv(const Vec3& lhs, const Vec3& rhs) {
+inline Vec3<T> Vec3<T>::CompDiv(const Vec3& lhs, const Vec3& rhs) {
     return Vec3(lhs.x / rhs.x, lhs.y / rhs.y, lhs.z / rhs.z);
 }
 
 // ***********************************************************************
 
 template<typename T>
-inline static T Vec3<T>::Dot(const Vec3& lhs, const Vec3& rhs) {
+inline T Vec3<T>::Dot(const Vec3& lhs, const Vec3& rhs) {
     return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
 }
 
@@ -0,0 +1,762 @@
+#ifdef _WIN32
+#pragma warning (disable : 5105)
+#include "Windows.h"
+#include "dbghelp.h"
+#undef min
+#undef max
+#pragma comment(lib, "gdi32")
+#pragma comment(lib, "kernel32")
+#pragma comment(lib, "psapi")
+#pragma comment(lib, "dbghelp")
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <stdint.h>
+
+#include "common_lib.h"
+#include "common_lib.cpp"
+
+// ***********************************************************************
+
+// Thread functions are declared with THREAD_PROC, so the same body builds against either thread API
+#ifdef _WIN32
+#define THREAD_PROC(name) DWORD WINAPI name(LPVOID pParam)
+typedef HANDLE TestThread;
+
+TestThread StartThread(LPTHREAD_START_ROUTINE pProc, void* pParam) {
+    return CreateThread(nullptr, 0, pProc, pParam, 0, nullptr);
+}
+
+void JoinThreads(TestThread* pThreads, int count) {
+    WaitForMultipleObjects(count, pThreads, true, INFINITE);
+    for (int i = 0; i < count; i++)
+        CloseHandle(pThreads[i]);
+}
+
+typedef SRWLOCK BenchmarkLock;
+#define BENCHMARK_LOCK_INIT SRWLOCK_INIT
+#define BenchmarkLockAcquire(pLock) AcquireSRWLockExclusive(pLock)
+#define BenchmarkLockRelease(pLock) ReleaseSRWLockExclusive(pLock)
+#else
+#define THREAD_PROC(name) void* name(void* pParam)
+typedef pthread_t TestThread;
+
+TestThread StartThread(void* (*pProc)(void*), void* pParam) {
+    pthread_t thread;
+    pthread_create(&thread, nullptr, pProc, pParam);
+    return thread;
+}
+
+void JoinThreads(TestThread* pThreads, int count) {
+    for (int i = 0; i < count; i++)
+        pthread_join(pThreads[i], nullptr);
+}
+
+typedef pthread_mutex_t BenchmarkLock;
+#define BENCHMARK_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define BenchmarkLockAcquire(pLock) pthread_mutex_lock(pLock)
+#define BenchmarkLockRelease(pLock) pthread_mutex_unlock(pLock)
+#endif
+
+// ---------------------
+// Benchmark helpers
+// ---------------------
+
+f64 GetTimeSeconds() {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (f64)counter.QuadPart / (f64)frequency.QuadPart;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (f64)time.tv_sec + (f64)time.tv_nsec / 1e9;
+#endif
+}
+
+void StartBenchmark(const char* benchmarkName) {
+    printf("Benchmark: %s\n", benchmarkName);
+}
+
+void ReportBenchmark(const char* label, f64 seconds, i64 operations) {
+    printf("  %-40s %10.3f ms %10.2f ns/op %10.2f Mops/s\n", label, seconds * 1000.0, seconds * 1e9 / (f64)operations, (f64)operations / seconds / 1e6);
+}
+
+// ---------------------
+// Benchmarks
+// ---------------------
+
+struct ArenaBenchmarkData {
+    Arena* pArena;
+    BenchmarkLock* pLock;
+    i64 allocations;
+};
+
+THREAD_PROC(ConcurrentArenaBenchmarkThread) {
+    ArenaBenchmarkData* pData = (ArenaBenchmarkData*)pParam;
+    for (i64 i = 0; i < pData->allocations; i++) {
+        ArenaAlloc(pData->pArena, 16 + (i & 63), 8, true);
+    }
+    return 0;
+}
+
+THREAD_PROC(LockedArenaBenchmarkThread) {
+    ArenaBenchmarkData* pData = (ArenaBenchmarkData*)pParam;
+    for (i64 i = 0; i < pData->allocations; i++) {
+        BenchmarkLockAcquire(pData->pLock);
+        ArenaAlloc(pData->pArena, 16 + (i & 63), 8, true);
+        BenchmarkLockRelease(pData->pLock);
+    }
+    return 0;
+}
+
+f64 RunArenaBenchmark(Arena* pArena, BenchmarkLock* pLock, int threadCount, i64 allocationsPerThread) {
+    ArenaBenchmarkData data[16];
+    TestThread threads[16];
+    f64 start = GetTimeSeconds();
+    for (int i = 0; i < threadCount; i++) {
+        data[i].pArena = pArena;
+        data[i].pLock = pLock;
+        data[i].allocations = allocationsPerThread;
+        threads[i] = StartThread(pLock ? LockedArenaBenchmarkThread : ConcurrentArenaBenchmarkThread, &data[i]);
+    }
+    JoinThreads(threads, threadCount);
+    return GetTimeSeconds() - start;
+}
+
+void ConcurrentArenaBenchmark() {
+    StartBenchmark("Shared arena allocation throughput");
+    const i64 allocationsPerThread = 1000000;
+
+    int threadCounts[] = { 1, 2, 4, 8 };
+    for (int threadCount : threadCounts) {
+        // Reserve enough that neither version ever runs out, and commit up front so we measure the allocation path
+        i64 reserve = threadCount * allocationsPerThread * 96;
+
+        Arena* pLocked = ArenaCreate(reserve);
+        ArenaAlloc(pLocked, reserve - pLocked->pageSize * 2, 8, true);
+        ArenaReset(pLocked);
+        BenchmarkLock lock = BENCHMARK_LOCK_INIT;
+        f64 lockedTime = RunArenaBenchmark(pLocked, &lock, threadCount, allocationsPerThread);
+        ArenaFinished(pLocked);
+
+        Arena* pConcurrent = ArenaCreate(reserve, false, AF_CONCURRENT);
+        ArenaAlloc(pConcurrent, reserve - pConcurrent->pageSize * 2, 8, true);
+        ArenaReset(pConcurrent);
+        f64 concurrentTime = RunArenaBenchmark(pConcurrent, nullptr, threadCount, allocationsPerThread);
+        ArenaFinished(pConcurrent);
+
+        printf(" %i threads\n", threadCount);
+        ReportBenchmark("mutex wrapped ArenaAlloc", lockedTime, threadCount * allocationsPerThread);
+        ReportBenchmark("AF_CONCURRENT ArenaAlloc", concurrentTime, threadCount * allocationsPerThread);
+    }
+    printf("\n");
+}
+
+f64 RunReserveBenchmark(i64 size, int repeats, bool emulateZeroing) {
+    f64 total = 0.0;
+    for (int i = 0; i < repeats; i++) {
+        // fresh arena each time so the pages really are new from the OS
+        Arena* pArena = ArenaCreate(size * 2);
+        f64 start = GetTimeSeconds();
+        ResizableArray<u8> array(pArena);
+        array.Reserve(size);
+        if (emulateZeroing) {
+            // what Reserve used to cost, ArenaAlloc zeroed the block then ArenaRealloc zeroed it again
+            memset(array.pData, 0, size);
+            memset(array.pData, 0, size);
+        }
+        // fill it, so both versions pay for faulting the pages in
+        memset(array.pData, 1, size);
+        total += GetTimeSeconds() - start;
+        ArenaFinished(pArena);
+    }
+    return total;
+}
+
+void ReserveZeroingBenchmark() {
+    StartBenchmark("Large ResizableArray::Reserve then fill, fresh pages");
+    const int repeats = 20;
+
+    i64 sizes[] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 128 * 1024 * 1024 };
+    for (i64 size : sizes) {
+        f64 zeroedTime = RunReserveBenchmark(size, repeats, true);
+        f64 watermarkTime = RunReserveBenchmark(size, repeats, false);
+
+        printf(" %lli KB\n", size / 1024);
+        ReportBenchmark("zeroed twice (old behaviour)", zeroedTime, repeats);
+        ReportBenchmark("known zero watermark", watermarkTime, repeats);
+    }
+    printf("\n");
+}
+
+void TrackerSamplingBenchmark() {
+    StartBenchmark("Memory tracker overhead by sampling rate");
+    const i64 operations = 200000;
+    const i64 liveSlots = 4096;
+
+    // Fake addresses, the tracker never touches the memory. Allocations churn through a fixed set of
+    // slots so the tracker's table stays a realistic size
+    u8* pAddresses = VirtualReserve(liveSlots * 1024);
+    i64 slotSizes[liveSlots] = {};
+
+    i64 sampleRates[] = { 0, 4096, 65536, 524288 };
+    for (i64 sampleRate : sampleRates) {
+        SetMemoryTrackingSampleRate(sampleRate);
+        i64 usageBefore = GetTrackedMemoryUsage();
+        i64 trueBytes = 0;
+        srand(11);
+
+        f64 start = GetTimeSeconds();
+        for (i64 i = 0; i < operations; i++) {
+            i64 slot = rand() % liveSlots;
+            if (slotSizes[slot]) {
+                CheckFree(pAddresses + slot * 1024);
+                trueBytes -= slotSizes[slot];
+            }
+            slotSizes[slot] = 16 + rand() % 1008;
+            CheckMalloc(pAddresses + slot * 1024, slotSizes[slot]);
+            trueBytes += slotSizes[slot];
+        }
+        f64 time = GetTimeSeconds() - start;
+        i64 estimate = GetTrackedMemoryUsage() - usageBefore;
+
+        for (i64 slot = 0; slot < liveSlots; slot++) {
+            if (slotSizes[slot])
+                CheckFree(pAddresses + slot * 1024);
+            slotSizes[slot] = 0;
+        }
+
+        char label[64];
+        if (sampleRate == 0)
+            snprintf(label, sizeof(label), "track everything");
+        else
+            snprintf(label, sizeof(label), "sample every %lli bytes", sampleRate);
+        ReportBenchmark(label, time, operations);
+        printf("  %-40s live %lli, estimated %lli (%+.2f%%)\n", "", trueBytes, estimate, 100.0 * f64(estimate - trueBytes) / f64(trueBytes));
+    }
+    SetMemoryTrackingSampleRate(MEMORY_TRACKING_SAMPLE_RATE);
+    VirtualRelease(pAddresses, liveSlots * 1024);
+    printf("\n");
+}
+
+void LogLatencyBenchmark() {
+    StartBenchmark("Log::Info caller latency, file output only");
+    const i64 messages = 20000;
+    f64* pTimes = (f64*)RawAlloc(messages * sizeof(f64));
+
+    const char* modes[] = { "synchronous", "async", "binary" };
+    for (int mode = 0; mode < 3; mode++) {
+        Log::LogConfig config;
+        config.winOutput = false;
+        config.consoleOutput = false;
+        config.asyncOutput = mode == 1;
+        config.binaryOutput = mode == 2;
+        config.asyncBufferSize = 1024 * 1024;
+        config.asyncOverflow = Log::EBlock;
+        Log::SetConfig(config);
+
+        f64 total = 0.0;
+        for (i64 i = 0; i < messages; i++) {
+            f64 start = GetTimeSeconds();
+            Log::Info("Benchmark message %lli with a little payload %f", i, f64(i) * 0.5);
+            pTimes[i] = GetTimeSeconds() - start;
+            total += pTimes[i];
+        }
+        Log::Flush();
+        Sort(pTimes, messages);
+
+        ReportBenchmark(modes[mode], total, messages);
+        printf("  %-40s median %.2f ns, p99 %.2f ns, max %.2f ns\n", "", pTimes[messages / 2] * 1e9, pTimes[messages * 99 / 100] * 1e9, pTimes[messages - 1] * 1e9);
+    }
+    Log::SetConfig(Log::LogConfig());
+    RawFree(pTimes);
+    printf("\n");
+}
+
+LOG_DEFINE_CATEGORY(Benchmark, Log::EInfo);
+
+void DisabledLogBenchmark() {
+    StartBenchmark("Disabled debug log calls");
+    const i64 calls = 10000000;
+    volatile i64 payload = 7;
+
+    Log::SetLogLevel(Log::EInfo);
+    f64 start = GetTimeSeconds();
+    for (i64 i = 0; i < calls; i++) {
+        Log::Debug("disabled %lli %lli", i, (i64)payload);
+    }
+    ReportBenchmark("Log::Debug, global level", GetTimeSeconds() - start, calls);
+    Log::SetLogLevel(Log::EDebug);
+
+    start = GetTimeSeconds();
+    for (i64 i = 0; i < calls; i++) {
+        LogDebug(Benchmark, "disabled %lli %lli", i, (i64)payload);
+    }
+    ReportBenchmark("LogDebug, category level", GetTimeSeconds() - start, calls);
+    printf("\n");
+}
+
+// The quadratic probing, tombstone based HashMap this library used before robin hood, kept to compare against
+template<typename K, typename V, typename KF = KeyFuncs<K>>
+struct QuadraticHashMap {
+    HashNode<K, V>* pTable { nullptr };
+    KF keyFuncs;
+    i64 tableSize { 0 };
+    i64 count { 0 };
+    i64 tombstoneCount { 0 };
+    Arena* pArena { nullptr };
+
+    u64 HashKey(const K& key) {
+        u64 hash = keyFuncs.Hash(key);
+        return hash < 2 ? hash + 2 : hash;
+    }
+
+    void Add(const K& key, const V& value) {
+        f32 loadFactor = tableSize == 0 ? INT_MAX : (f32)(count + tombstoneCount) / (f32)tableSize;
+        if (loadFactor >= 0.9f)
+            Rehash(count * 2 < tableSize ? tableSize : tableSize + 1);
+
+        u64 hash = HashKey(key);
+        u64 index = hash % tableSize;
+        u64 probeCounter = 1;
+        while (pTable[index].hash >= 2) {
+            index = (index + probeCounter) % tableSize;
+            probeCounter++;
+        }
+        if (pTable[index].hash == 1)
+            tombstoneCount--;
+        pTable[index].hash = hash;
+        pTable[index].key = key;
+        pTable[index].value = value;
+        count++;
+    }
+
+    // returns the slot, and how many slots were looked at to find it
+    i64 Find(const K& key, i64& probes) {
+        probes = 0;
+        if (tableSize == 0)
+            return -1;
+        u64 hash = HashKey(key);
+        u64 index = hash % tableSize;
+        u64 probeCounter = 1;
+        while (pTable[index].hash != 0) {
+            probes++;
+            if (pTable[index].hash == hash && keyFuncs.Cmp(pTable[index].key, key))
+                return index;
+            index = (index + probeCounter) % tableSize;
+            probeCounter++;
+        }
+        return -1;
+    }
+
+    V* Get(const K& key) {
+        i64 probes;
+        i64 index = Find(key, probes);
+        return index >= 0 ? &pTable[index].value : nullptr;
+    }
+
+    void Erase(const K& key) {
+        i64 probes;
+        i64 index = Find(key, probes);
+        if (index < 0)
+            return;
+        memset(&pTable[index], 0, sizeof(HashNode<K, V>));
+        pTable[index].hash = 1;
+        count--;
+        tombstoneCount++;
+    }
+
+    void Rehash(i64 requiredTableSize) {
+        HashNode<K, V>* pTableOld = pTable;
+        i64 newTableSize = 32;
+        while (newTableSize < requiredTableSize)
+            newTableSize *= 2;
+        pTable = (HashNode<K, V>*)ArenaAlloc(pArena, sizeof(HashNode<K, V>) * newTableSize, alignof(HashNode<K, V>), false);
+        i64 oldTableSize = tableSize;
+        tableSize = newTableSize;
+        tombstoneCount = 0;
+        for (i64 i = 0; i < oldTableSize; i++) {
+            if (pTableOld[i].hash >= 2) {
+                Add(pTableOld[i].key, pTableOld[i].value);
+                count--;
+            }
+        }
+    }
+};
+
+u64 BenchmarkKey(u64 i) {
+    // spread out but repeatable keys, so both maps see the same ones
+    u64 x = i * 0x9E3779B97F4A7C15ull;
+    return (x ^ (x >> 29)) & 0xffffffffffffull;
+}
+
+void PrintProbeHistogram(const char* label, i64* pBuckets, i64 total, i64 probeSum, i64 maxProbes) {
+    printf("  %-40s mean %.2f, max %lli |", label, (f64)probeSum / (f64)total, maxProbes);
+    const char* names[] = { "1", "2", "3-4", "5-8", "9-16", "17+" };
+    for (int i = 0; i < 6; i++) {
+        printf(" %s: %.1f%%", names[i], 100.0 * (f64)pBuckets[i] / (f64)total);
+    }
+    printf("\n");
+}
+
+int ProbeBucket(i64 probes) {
+    if (probes <= 1) return 0;
+    if (probes <= 2) return 1;
+    if (probes <= 4) return 2;
+    if (probes <= 8) return 3;
+    if (probes <= 16) return 4;
+    return 5;
+}
+
+template<typename Map>
+void RunHashMapBenchmark(Map& map, const char* name, i64 keys) {
+    char label[64];
+    f64 start = GetTimeSeconds();
+    for (i64 i = 0; i < keys; i++) {
+        map.Add(BenchmarkKey(i), i);
+    }
+    snprintf(label, sizeof(label), "%s insert", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, keys);
+
+    i64 found = 0;
+    start = GetTimeSeconds();
+    for (i64 i = 0; i < keys; i++) {
+        found += map.Get(BenchmarkKey(i)) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s lookup hit", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, keys);
+
+    start = GetTimeSeconds();
+    for (i64 i = keys; i < keys * 2; i++) {
+        found += map.Get(BenchmarkKey(i)) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s lookup miss", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, keys);
+
+    // churn, erase half and add as many new keys, tombstones make this worse over time
+    start = GetTimeSeconds();
+    for (i64 i = 0; i < keys; i += 2) {
+        map.Erase(BenchmarkKey(i));
+        map.Add(BenchmarkKey(keys * 2 + i), i);
+    }
+    snprintf(label, sizeof(label), "%s erase + insert", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, keys);
+
+    start = GetTimeSeconds();
+    for (i64 i = 1; i < keys; i += 2) {
+        found += map.Get(BenchmarkKey(i)) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s lookup hit after churn", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, keys / 2);
+    if (found != keys + keys / 2)
+        printf("  %s lost keys!\n", name);
+}
+
+void HashMapBenchmark() {
+    StartBenchmark("HashMap, robin hood vs old quadratic probing");
+    i64 sizes[] = { 1000, 100000, 1000000 };
+    for (i64 keys : sizes) {
+        printf(" %lli keys\n", keys);
+
+        Arena* pArena = ArenaCreate();
+        HashMap<u64, i64> robinHood(pArena);
+        RunHashMapBenchmark(robinHood, "robin hood", keys);
+        QuadraticHashMap<u64, i64> quadratic;
+        quadratic.pArena = pArena;
+        RunHashMapBenchmark(quadratic, "quadratic", keys);
+
+        // how many slots a lookup of each live key has to look at
+        i64 buckets[6] = {};
+        i64 probeSum = 0;
+        i64 maxProbes = 0;
+        for (i64 i = 0; i < robinHood.tableSize; i++) {
+            if (robinHood.pTable[i].hash == UNUSED_HASH)
+                continue;
+            i64 probes = robinHood.ProbeLength(i) + 1;
+            buckets[ProbeBucket(probes)]++;
+            probeSum += probes;
+            maxProbes = probes > maxProbes ? probes : maxProbes;
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "robin hood probes (load %.2f)", (f64)robinHood.count / (f64)robinHood.tableSize);
+        PrintProbeHistogram(label, buckets, robinHood.count, probeSum, maxProbes);
+
+        memset(buckets, 0, sizeof(buckets));
+        probeSum = 0;
+        maxProbes = 0;
+        for (i64 i = 0; i < quadratic.tableSize; i++) {
+            if (quadratic.pTable[i].hash < 2)
+                continue;
+            i64 probes;
+            quadratic.Find(quadratic.pTable[i].key, probes);
+            buckets[ProbeBucket(probes)]++;
+            probeSum += probes;
+            maxProbes = probes > maxProbes ? probes : maxProbes;
+        }
+        snprintf(label, sizeof(label), "quadratic probes (load %.2f)", (f64)(quadratic.count + quadratic.tombstoneCount) / (f64)quadratic.tableSize);
+        PrintProbeHistogram(label, buckets, quadratic.count, probeSum, maxProbes);
+        ArenaFinished(pArena);
+    }
+    printf("\n");
+}
+
+struct BenchmarkBigValue {
+    i64 data[8];
+};
+
+template<typename Map>
+void RunLookupBenchmark(Map& map, const char* name, i64 keys, i64 lookups) {
+    char label[64];
+    f64 start = GetTimeSeconds();
+    for (i64 i = 0; i < keys; i++) {
+        BenchmarkBigValue value;
+        value.data[0] = i;
+        map.Add(BenchmarkKey(i), value);
+    }
+    snprintf(label, sizeof(label), "%s insert", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, keys);
+
+    i64 found = 0;
+    start = GetTimeSeconds();
+    for (i64 i = 0; i < lookups; i++) {
+        found += map.Get(BenchmarkKey(i % keys)) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s lookup hit", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, lookups);
+
+    start = GetTimeSeconds();
+    for (i64 i = 0; i < lookups; i++) {
+        found += map.Get(BenchmarkKey(keys + i)) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s lookup miss", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, lookups);
+    if (found != lookups)
+        printf("  %s lookups went wrong!\n", name);
+}
+
+template<typename Map>
+void RunStringLookupBenchmark(Map& map, const char* name, String* pKeys, i64 keys, String* pMisses, i64 lookups) {
+    char label[64];
+    for (i64 i = 0; i < keys; i++) {
+        map.Add(pKeys[i], i);
+    }
+
+    i64 found = 0;
+    f64 start = GetTimeSeconds();
+    for (i64 i = 0; i < lookups; i++) {
+        found += map.Get(pKeys[i % keys]) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s string hit", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, lookups);
+
+    start = GetTimeSeconds();
+    for (i64 i = 0; i < lookups; i++) {
+        found += map.Get(pMisses[i % keys]) != nullptr;
+    }
+    snprintf(label, sizeof(label), "%s string miss", name);
+    ReportBenchmark(label, GetTimeSeconds() - start, lookups);
+    if (found != lookups)
+        printf("  %s lookups went wrong!\n", name);
+}
+
+void FlatHashMapBenchmark() {
+    StartBenchmark("FlatHashMap vs HashMap, 64 byte values");
+    const i64 lookups = 2000000;
+    i64 sizes[] = { 1000, 100000, 1000000 };
+    for (i64 keys : sizes) {
+        printf(" %lli keys\n", keys);
+        // both maps and every table they grew out of stay in here, far more than the default reserve at 1M keys
+        Arena* pArena = ArenaCreate(4ll * 1024 * 1024 * 1024);
+        HashMap<u64, BenchmarkBigValue> hashMap(pArena);
+        RunLookupBenchmark(hashMap, "HashMap", keys, lookups);
+        FlatHashMap<u64, BenchmarkBigValue> flatMap(pArena);
+        RunLookupBenchmark(flatMap, "FlatHashMap", keys, lookups);
+        ArenaFinished(pArena);
+    }
+
+    // identifier-like keys, misses share prefixes with the hits like symbol lookups tend to
+    const i64 stringKeys = 50000;
+    Arena* pArena = ArenaCreate();
+    String* pKeys = New(pArena, String, stringKeys);
+    String* pMisses = New(pArena, String, stringKeys);
+    for (i64 i = 0; i < stringKeys; i++) {
+        pKeys[i] = StringPrint(pArena, "Namespace::Symbol_%lli", i);
+        pMisses[i] = StringPrint(pArena, "Namespace::Symbol_%lli_missing", i);
+    }
+    printf(" %lli string keys\n", stringKeys);
+    HashMap<String, i64> hashMap(pArena);
+    RunStringLookupBenchmark(hashMap, "HashMap", pKeys, stringKeys, pMisses, lookups);
+    FlatHashMap<String, i64> flatMap(pArena);
+    RunStringLookupBenchmark(flatMap, "FlatHashMap", pKeys, stringKeys, pMisses, lookups);
+    ArenaFinished(pArena);
+    printf("\n");
+}
+
+u64 OldFnvHash(const String& key) {
+    u64 nbytes = key.length;
+    u64 hash = 0x811C9DC5;
+    const u8* pData = (const u8*)key.pData;
+    while (nbytes--)
+        hash = (*pData++ ^ hash) * 0x01000193;
+    return hash;
+}
+
+void HashFunctionBenchmark() {
+    StartBenchmark("String hash throughput, old FNV-1a vs HashBytes");
+    const i64 iterations = 2000000;
+    char buffer[256 + 16];
+    for (i64 i = 0; i < 256 + 16; i++) {
+        buffer[i] = char('a' + i % 23);
+    }
+
+    i64 lengths[] = { 8, 24, 64, 256 };
+    for (i64 length : lengths) {
+        String key;
+        key.length = length;
+        volatile u64 sink = 0;
+        char label[64];
+
+        // slide the key along the buffer to vary it, writing into it would stall the wide reads on store forwarding
+
+        f64 start = GetTimeSeconds();
+        for (i64 i = 0; i < iterations; i++) {
+            key.pData = buffer + (i & 15);
+            sink = sink + OldFnvHash(key);
+        }
+        f64 time = GetTimeSeconds() - start;
+        snprintf(label, sizeof(label), "FNV-1a, %lli bytes", length);
+        ReportBenchmark(label, time, iterations);
+        printf("  %-40s %.2f GB/s\n", "", (f64)(iterations * length) / time / 1e9);
+
+        start = GetTimeSeconds();
+        for (i64 i = 0; i < iterations; i++) {
+            key.pData = buffer + (i & 15);
+            sink = sink + HashBytes(key.pData, key.length);
+        }
+        time = GetTimeSeconds() - start;
+        snprintf(label, sizeof(label), "HashBytes, %lli bytes", length);
+        ReportBenchmark(label, time, iterations);
+        printf("  %-40s %.2f GB/s\n", "", (f64)(iterations * length) / time / 1e9);
+    }
+    printf("\n");
+}
+
+void HashMapBuildBenchmark() {
+    StartBenchmark("HashMap building a map of known size");
+    const i64 keys = 1000000;
+    const i64 rounds = 5;
+    u64* pKeys = (u64*)RawAlloc(keys * sizeof(u64));
+    i64* pValues = (i64*)RawAlloc(keys * sizeof(i64));
+    for (i64 i = 0; i < keys; i++) {
+        pKeys[i] = BenchmarkKey(i);
+        pValues[i] = i;
+    }
+
+    Arena* pArena = ArenaCreate(4ll * 1024 * 1024 * 1024);
+    f64 start = GetTimeSeconds();
+    for (i64 round = 0; round < rounds; round++) {
+        HashMap<u64, i64> map(pArena);
+        map.releaseOldTables = true;
+        for (i64 i = 0; i < keys; i++) {
+            map.Add(pKeys[i], pValues[i]);
+        }
+    }
+    ReportBenchmark("Add, growing as it goes", GetTimeSeconds() - start, keys * rounds);
+    printf("  %-40s %.1f MB committed per map\n", "", (f64)ArenaCommittedBytes(pArena) / rounds / (1024.0 * 1024.0));
+    ArenaReset(pArena);
+
+    start = GetTimeSeconds();
+    for (i64 round = 0; round < rounds; round++) {
+        HashMap<u64, i64> map(pArena);
+        map.Reserve(keys);
+        for (i64 i = 0; i < keys; i++) {
+            map.Add(pKeys[i], pValues[i]);
+        }
+    }
+    ReportBenchmark("Reserve then Add", GetTimeSeconds() - start, keys * rounds);
+    ArenaReset(pArena);
+
+    start = GetTimeSeconds();
+    for (i64 round = 0; round < rounds; round++) {
+        HashMap<u64, i64> map(pArena);
+        map.AddBulk(pKeys, pValues, keys);
+    }
+    ReportBenchmark("AddBulk", GetTimeSeconds() - start, keys * rounds);
+    printf("  %-40s %.1f MB committed per map\n", "", (f64)ArenaCommittedBytes(pArena) / rounds / (1024.0 * 1024.0));
+    ArenaReset(pArena);
+
+    HashMap<u64, i64> map(pArena);
+    start = GetTimeSeconds();
+    for (i64 round = 0; round < rounds; round++) {
+        map.Clear();
+        map.AddBulk(pKeys, pValues, keys);
+    }
+    ReportBenchmark("Clear then AddBulk, reused table", GetTimeSeconds() - start, keys * rounds);
+
+    ArenaFinished(pArena);
+    RawFree(pKeys);
+    RawFree(pValues);
+    printf("\n");
+}
+
+void HashMapGrowthBenchmark() {
+    StartBenchmark("HashMap growing to 1M keys, memory and worst case Add");
+    const i64 keys = 1000000;
+    f64* pTimes = (f64*)RawAlloc(keys * sizeof(f64));
+
+    i64 steps[] = { 0, 16, 64 };
+    for (i64 step : steps) {
+        Arena* pArena = ArenaCreate(4ll * 1024 * 1024 * 1024);
+        HashMap<u64, BenchmarkBigValue> map(pArena);
+        map.rehashStep = step;
+        map.releaseOldTables = true;
+        f64 total = 0.0;
+        for (i64 i = 0; i < keys; i++) {
+            BenchmarkBigValue value;
+            value.data[0] = i;
+            f64 start = GetTimeSeconds();
+            map.Add(BenchmarkKey(i), value);
+            pTimes[i] = GetTimeSeconds() - start;
+            total += pTimes[i];
+        }
+        f64 tableMegabytes = (f64)(map.tableSize * sizeof(HashNode<u64, BenchmarkBigValue>)) / (1024.0 * 1024.0);
+        f64 committedMegabytes = (f64)ArenaCommittedBytes(pArena) / (1024.0 * 1024.0);
+        Sort(pTimes, keys);
+
+        char label[64];
+        snprintf(label, sizeof(label), step == 0 ? "rehash all at once" : "incremental rehash, step %lli", step);
+        ReportBenchmark(label, total, keys);
+        printf("  %-40s p99 %.2f ns, p99.99 %.2f us, max %.2f ms\n", "", pTimes[keys * 99 / 100] * 1e9, pTimes[keys - keys / 10000] * 1e6, pTimes[keys - 1] * 1e3);
+        printf("  %-40s %.1f MB committed for a %.1f MB table\n", "", committedMegabytes, tableMegabytes);
+        ArenaFinished(pArena);
+    }
+    RawFree(pTimes);
+    printf("\n");
+}
+
+int main() {
+	g_pArenaFrame = ArenaCreate();
+	g_pArenaPermenant = ArenaCreate();
+
+    ConcurrentArenaBenchmark();
+    ReserveZeroingBenchmark();
+    TrackerSamplingBenchmark();
+    LogLatencyBenchmark();
+    DisabledLogBenchmark();
+    HashMapBenchmark();
+    HashMapBuildBenchmark();
+    HashMapGrowthBenchmark();
+    FlatHashMapBenchmark();
+    HashFunctionBenchmark();
+    return 0;
+}
@@ -1,4 +1,5 @@
 
+#ifdef _WIN32
 #pragma warning (disable : 5105)
 #include "Windows.h"
 #include "dbghelp.h"
@@ -8,6 +9,10 @@
 #pragma comment(lib, "kernel32")
 #pragma comment(lib, "psapi")
 #pragma comment(lib, "dbghelp")
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
 
 #include <math.h>
 #include <stdio.h>
@@ -20,6 +25,38 @@
 #include "common_lib.h"
 #include "common_lib.cpp"
 
+// ***********************************************************************
+
+// Thread functions are declared with THREAD_PROC, so the same body builds against either thread API
+#ifdef _WIN32
+#define THREAD_PROC(name) DWORD WINAPI name(LPVOID pParam)
+typedef HANDLE TestThread;
+
+TestThread StartThread(LPTHREAD_START_ROUTINE pProc, void* pParam) {
+    return CreateThread(nullptr, 0, pProc, pParam, 0, nullptr);
+}
+
+void JoinThreads(TestThread* pThreads, int count) {
+    WaitForMultipleObjects(count, pThreads, true, INFINITE);
+    for (int i = 0; i < count; i++)
+        CloseHandle(pThreads[i]);
+}
+#else
+#define THREAD_PROC(name) void* name(void* pParam)
+typedef pthread_t TestThread;
+
+TestThread StartThread(void* (*pProc)(void*), void* pParam) {
+    pthread_t thread;
+    pthread_create(&thread, nullptr, pProc, pParam);
+    return thread;
+}
+
+void JoinThreads(TestThread* pThreads, int count) {
+    for (int i = 0; i < count; i++)
+        pthread_join(pThreads[i], nullptr);
+}
+#endif
+
 // ---------------------
 // Tests
 // ---------------------
@@ -83,6 +120,150 @@ void HashMapTest() {
         VERIFY(testMap.Get(12) == nullptr);
         VERIFY(testMap.Get(87) == nullptr);
 
+        // Erasing from the middle of a probe chain mustn't lose the keys after it
+        HashMap<int, int> chainMap(pArena);
+        chainMap.Add(5, 1);
+        chainMap.Add(5 + 32, 2);
+        chainMap.Add(5 + 64, 3);
+        chainMap.Erase(5 + 32);
+        VERIFY(chainMap.Get(5 + 64) != nullptr && *chainMap.Get(5 + 64) == 3);
+        chainMap[5 + 32] = 4;
+        VERIFY(chainMap.count == 3);
+        VERIFY(chainMap[5 + 32] == 4);
+
+        // Heavy churn at high load, every key must stay reachable and nothing may be left behind
+        HashMap<int, int> churnMap(pArena);
+        int present[1024] = {};
+        srand(3);
+        for (int i = 0; i < 20000; i++) {
+            int key = rand() % 1024;
+            if (present[key]) {
+                churnMap.Erase(key * 64); // multiples of the table size pile up in the same home slots
+                present[key] = 0;
+            } else {
+                churnMap.Add(key * 64, key);
+                present[key] = 1;
+            }
+        }
+        int expectedCount = 0;
+        int missing = 0;
+        for (int key = 0; key < 1024; key++) {
+            int* pValue = churnMap.Get(key * 64);
+            if (present[key]) {
+                expectedCount++;
+                if (pValue == nullptr || *pValue != key)
+                    missing++;
+            } else if (pValue != nullptr) {
+                missing++;
+            }
+        }
+        VERIFY(missing == 0);
+        VERIFY(churnMap.count == expectedCount);
+        int occupied = 0;
+        for (i64 i = 0; i < churnMap.tableSize; i++) {
+            if (churnMap.pTable[i].hash != UNUSED_HASH)
+                occupied++;
+        }
+        VERIFY(occupied == expectedCount);
+
+        // Iteration visits every key exactly once
+        int visited = 0;
+        int visitedWrong = 0;
+        for (HashNode<int, int>& node : churnMap) {
+            visited++;
+            if (node.key != node.value * 64 || !present[node.value])
+                visitedWrong++;
+        }
+        VERIFY(visited == expectedCount);
+        VERIFY(visitedWrong == 0);
+
+        HashMap<int, int> emptyMap(pArena);
+        VERIFY(!(emptyMap.begin() != emptyMap.end()));
+
+        // Reserving up front means no rehashing while adding
+        HashMap<int, int> reservedMap(pArena);
+        reservedMap.Reserve(1000);
+        i64 reservedSize = reservedMap.tableSize;
+        VERIFY(reservedSize * 7 >= 1000 * 8);
+        for (int i = 0; i < 1000; i++) {
+            reservedMap.Add(i, i);
+        }
+        VERIFY(reservedMap.tableSize == reservedSize);
+        reservedMap.Reserve(10);
+        VERIFY(reservedMap.tableSize == reservedSize);
+
+        int bulkKeys[500];
+        int bulkValues[500];
+        for (int i = 0; i < 500; i++) {
+            bulkKeys[i] = i * 7;
+            bulkValues[i] = i;
+        }
+        HashMap<int, int> bulkMap(pArena);
+        bulkMap.Add(-1, -1);
+        bulkMap.AddBulk(bulkKeys, bulkValues, 500);
+        VERIFY(bulkMap.count == 501);
+        int bulkMissing = 0;
+        for (int i = 0; i < 500; i++) {
+            int* pValue = bulkMap.Get(i * 7);
+            if (pValue == nullptr || *pValue != i)
+                bulkMissing++;
+        }
+        VERIFY(bulkMissing == 0);
+        VERIFY(*bulkMap.Get(-1) == -1);
+
+        // Clear keeps the table for reuse
+        HashNode<int, int>* pBulkTable = bulkMap.pTable;
+        bulkMap.Clear();
+        VERIFY(bulkMap.count == 0);
+        VERIFY(bulkMap.Get(7) == nullptr);
+        VERIFY(!(bulkMap.begin() != bulkMap.end()));
+        bulkMap.AddBulk(bulkKeys, bulkValues, 500);
+        VERIFY(bulkMap.pTable == pBulkTable);
+        VERIFY(*bulkMap.Get(7 * 499) == 499);
+
+        // Incremental rehash, keys must stay reachable while they're split between the two tables
+        HashMap<int, int> incrementalMap(pArena);
+        incrementalMap.rehashStep = 4;
+        int incrementalWrong = 0;
+        bool sawOldTable = false;
+        int iteratedMidRehash = -1;
+        for (int i = 0; i < 5000; i++) {
+            incrementalMap.Add(i, i);
+            if (i % 3 == 0)
+                incrementalMap.Erase(i / 2);
+            sawOldTable |= incrementalMap.pOldTable != nullptr;
+            if (iteratedMidRehash < 0 && incrementalMap.pOldTable && incrementalMap.count > 1000) {
+                // iterating walks both tables and leaves the rehash where it was
+                HashNode<int, int>* pOldTable = incrementalMap.pOldTable;
+                iteratedMidRehash = 0;
+                for (HashNode<int, int>& node : incrementalMap) {
+                    iteratedMidRehash++;
+                    (void)node;
+                }
+                VERIFY(iteratedMidRehash == incrementalMap.count);
+                VERIFY(incrementalMap.pOldTable == pOldTable);
+            }
+            if (incrementalMap.Get(i) == nullptr && i % 3 != 0)
+                incrementalWrong++;
+        }
+        VERIFY(sawOldTable);
+        for (int i = 0; i < 5000; i++) {
+            bool erased = i < 2500 && i * 2 % 3 == 0; // erased as i / 2 when i was a multiple of 3
+            bool erasedOdd = i < 2500 && (i * 2 + 1) % 3 == 0;
+            int* pValue = incrementalMap.Get(i);
+            if ((erased || erasedOdd) != (pValue == nullptr) || (pValue && *pValue != i))
+                incrementalWrong++;
+        }
+        VERIFY(incrementalWrong == 0);
+        i64 incrementalCount = incrementalMap.count;
+        int iterated = 0;
+        for (HashNode<int, int>& node : incrementalMap) {
+            iterated++;
+            (void)node;
+        }
+        VERIFY(iteratedMidRehash > 0);
+        VERIFY(iterated == incrementalCount);
+
         HashMap<String, int> testMap2(pArena);
 
         testMap2.GetOrAdd("Dave") = 27;
@@ -172,10 +353,268 @@ void HashMapTest() {
 
 		ArenaFinished(pArena);
     }
+    {
+        // Growing big maps that ask for it gives the old tables back, only the last one is still committed
+        Arena* pArena = ArenaCreate();
+        HashMap<i64, i64> bigMap(pArena);
+        FlatHashMap<i64, i64> bigFlatMap(pArena);
+        bigMap.releaseOldTables = true;
+        bigFlatMap.releaseOldTables = true;
+        for (i64 i = 0; i < 200000; i++) {
+            bigMap.Add(i, i);
+            bigFlatMap.Add(i, i);
+        }
+        i64 tablesSize = bigMap.tableSize * sizeof(HashNode<i64, i64>) + bigFlatMap.AllocationSize(bigFlatMap.tableSize);
+        // tables smaller than a large block still stay in the arena, those add up to less than two large blocks per map
+        VERIFY(ArenaCommittedBytes(pArena) < tablesSize + 4 * ARENA_LARGE_BLOCK_SIZE);
+        ArenaFinished(pArena);
+    }
+    {
+        // By default a copy taken before the map grew can still read the table it was given
+        Arena* pArena = ArenaCreate();
+        HashMap<i64, i64> map(pArena);
+        FlatHashMap<i64, i64> flatMap(pArena);
+        for (i64 i = 0; i < 50000; i++) {
+            map.Add(i, i);
+            flatMap.Add(i, i);
+        }
+        HashMap<i64, i64> copy = map;
+        FlatHashMap<i64, i64> flatCopy = flatMap;
+        for (i64 i = 50000; i < 200000; i++) {
+            map.Add(i, i);
+            flatMap.Add(i, i);
+        }
+        int copyWrong = 0;
+        for (i64 i = 0; i < 50000; i++) {
+            i64* pValue = copy.Get(i);
+            i64* pFlatValue = flatCopy.Get(i);
+            if (pValue == nullptr || *pValue != i || pFlatValue == nullptr || *pFlatValue != i)
+                copyWrong++;
+        }
+        VERIFY(copyWrong == 0);
+        ArenaFinished(pArena);
+    }
     errorCount += ReportMemoryLeaks();
     EndTest(errorCount);
 }
 
+void FlatHashMapTest() {
+    StartTest("FlatHashMap Test");
+    int errorCount = 0;
+    {
+		Arena* pArena = ArenaCreate();
+        FlatHashMap<int, int> testMap(pArena);
+
+        testMap.Add(1337, 22);
+        testMap.Add(52, 21);
+        testMap.Add(87, 20);
+        testMap.Add(12, 19);
+        VERIFY(testMap.tableSize == 32);
+        VERIFY(testMap.count == 4);
+        VERIFY(*testMap.Get(1337) == 22);
+        VERIFY(*testMap.Get(52) == 21);
+        VERIFY(*testMap.Get(87) == 20);
+        VERIFY(*testMap.Get(12) == 19);
+        VERIFY(testMap.Get(13) == nullptr);
+
+        testMap.Erase(52);
+        testMap.Erase(52);
+        VERIFY(testMap.count == 3);
+        VERIFY(testMap.Get(52) == nullptr);
+        VERIFY(*testMap.Get(87) == 20);
+
+        testMap[52] = 5;
+        testMap[52] += 1;
+        VERIFY(testMap[52] == 6);
+        VERIFY(testMap.count == 4);
+
+        // Churn through more keys than fit, checking against a plain array. Keys that all hash into one group
+        // fill it up, so erases have to leave deleted markers and probes have to run past full groups
+        FlatHashMap<i64, i64> churnMap(pArena);
+        i64 present[2048] = {};
+        srand(5);
+        for (int i = 0; i < 40000; i++) {
+            i64 key = rand() % 2048;
+            if (present[key]) {
+                churnMap.Erase(key << 20);
+                present[key] = 0;
+            } else {
+                churnMap.Add(key << 20, key);
+                present[key] = 1;
+            }
+        }
+        i64 expectedCount = 0;
+        i64 wrong = 0;
+        for (i64 key = 0; key < 2048; key++) {
+            i64* pValue = churnMap.Get(key << 20);
+            if (present[key]) {
+                expectedCount++;
+                wrong += pValue == nullptr || *pValue != key;
+            } else {
+                wrong += pValue != nullptr;
+            }
+        }
+        VERIFY(wrong == 0);
+        VERIFY(churnMap.count == expectedCount);
+        VERIFY((churnMap.count + churnMap.deletedCount) * 8 <= churnMap.tableSize * 7);
+
+        // Big values and string keys, the case it's meant for
+        struct BigValue {
+            i64 data[16];
+        };
+        FlatHashMap<String, BigValue> stringMap(pArena);
+        for (int i = 0; i < 1000; i++) {
+            BigValue value;
+            value.data[0] = i;
+            stringMap.Add(StringPrint(pArena, "key %i", i), value);
+        }
+        VERIFY(stringMap.count == 1000);
+        VERIFY(stringMap.Get("key 0")->data[0] == 0);
+        VERIFY(stringMap.Get("key 999")->data[0] == 999);
+        VERIFY(stringMap.Get("key 1000") == nullptr);
+        VERIFY(stringMap.Get("nope") == nullptr);
+
+        FlatHashMap<void*, int> pointerMap(pArena);
+        int arr[3];
+        pointerMap[arr] = 1;
+        pointerMap[arr + 1] = 2;
+        pointerMap[arr + 2] = 3;
+        VERIFY(pointerMap[arr + 1] == 2 && pointerMap.count == 3);
+
+		ArenaFinished(pArena);
+    }
+    errorCount += ReportMemoryLeaks();
+    EndTest(errorCount);
+}
+
+u64 g_hashTestState = 0x853c49e6748fea9bull;
+
+u64 HashTestRandom() {
+    g_hashTestState ^= g_hashTestState << 13;
+    g_hashTestState ^= g_hashTestState >> 7;
+    g_hashTestState ^= g_hashTestState << 17;
+    return g_hashTestState;
+}
+
+// How many keys landed in an already used slot of a power of two table, over how many you'd expect if the
+// hashes were truly random. Tables use the low bits, so that's what is checked
+f64 HashCollisionRatio(u64* pHashes, i64 count) {
+    i64 buckets = 1;
+    while (buckets < count)
+        buckets *= 2;
+    Arena* pArena = ArenaCreate();
+    u8* pUsed = (u8*)ArenaAlloc(pArena, buckets, 1);
+    i64 collisions = 0;
+    for (i64 i = 0; i < count; i++) {
+        u64 bucket = pHashes[i] & (buckets - 1);
+        collisions += pUsed[bucket];
+        pUsed[bucket] = 1;
+    }
+    ArenaFinished(pArena);
+    f64 expectedUsed = (f64)buckets * (1.0 - pow(1.0 - 1.0 / (f64)buckets, (f64)count));
+    return (f64)collisions / ((f64)count - expectedUsed);
+}
+
+// For each input bit, the fraction of output bits that flip when it does, should be close to a half for all of them
+// Returns the worst distance from a half
+f64 HashAvalancheBias(u64 (*hash)(const u8*, i64), i64 length) {
+    const i64 samples = 400;
+    f64 worst = 0.0;
+    u8 key[64];
+    i64* pFlips = (i64*)ArenaAlloc(g_pArenaFrame, length * 8 * sizeof(i64), alignof(i64));
+    for (i64 sample = 0; sample < samples; sample++) {
+        for (i64 i = 0; i < length; i++) {
+            key[i] = (u8)HashTestRandom();
+        }
+        u64 base = hash(key, length);
+        for (i64 bit = 0; bit < length * 8; bit++) {
+            key[bit / 8] ^= u8(1 << (bit % 8));
+            u64 flipped = base ^ hash(key, length);
+            key[bit / 8] ^= u8(1 << (bit % 8));
+            for (int outBit = 0; outBit < 64; outBit++) {
+                pFlips[bit] += (flipped >> outBit) & 1;
+            }
+        }
+    }
+    for (i64 bit = 0; bit < length * 8; bit++) {
+        f64 ratio = (f64)pFlips[bit] / (f64)(samples * 64);
+        f64 bias = ratio > 0.5 ? ratio - 0.5 : 0.5 - ratio;
+        worst = bias > worst ? bias : worst;
+    }
+    return worst;
+}
+
+u64 HashIntBytes(const u8* pKey, i64 length) {
+    u64 key;
+    memcpy(&key, pKey, 8);
+    return KeyFuncs<u64>().Hash(key);
+}
+
+u64 HashStringBytes(const u8* pKey, i64 length) {
+    String key;
+    key.pData = (char*)pKey;
+    key.length = length;
+    return KeyFuncs<String>().Hash(key);
+}
+
+void HashQualityTest() {
+    StartTest("Hash Quality Test");
+    int errorCount = 0;
+    {
+        const i64 count = 50000;
+        u64* pHashes = (u64*)ArenaAlloc(g_pArenaFrame, count * sizeof(u64), alignof(u64));
+
+        // The key shapes our maps actually see, none of them should do worse than random
+        for (i64 i = 0; i < count; i++) {
+            pHashes[i] = KeyFuncs<i32>().Hash((i32)i);
+        }
+        VERIFY(HashCollisionRatio(pHashes, count) < 1.1);
+
+        for (i64 i = 0; i < count; i++) {
+            pHashes[i] = KeyFuncs<u64>().Hash(u64(i) << 12); // page strided ids
+        }
+        VERIFY(HashCollisionRatio(pHashes, count) < 1.1);
+
+        u8* pBase = (u8*)0x7f0000001000ull;
+        for (i64 i = 0; i < count; i++) {
+            pHashes[i] = KeyFuncs<u8*>().Hash(pBase + i * 48); // allocations from one arena
+        }
+        VERIFY(HashCollisionRatio(pHashes, count) < 1.1);
+
+        for (i64 i = 0; i < count; i++) {
+            pHashes[i] = KeyFuncs<f32>().Hash(f32(i) * 0.25f);
+        }
+        VERIFY(HashCollisionRatio(pHashes, count) < 1.1);
+        VERIFY(KeyFuncs<f32>().Hash(0.0f) == KeyFuncs<f32>().Hash(-0.0f));
+        VERIFY(KeyFuncs<f32>().Hash(0.25f) != KeyFuncs<f32>().Hash(0.5f));
+
+        for (i64 i = 0; i < count; i++) {
+            pHashes[i] = KeyFuncs<String>().Hash(TempPrint("entity_%lli", i));
+        }
+        VERIFY(HashCollisionRatio(pHashes, count) < 1.1);
+
+        // every length takes a slightly different path through the string hash
+        for (i64 i = 0; i < count; i++) {
+            String key = TempPrint("%lli", i * 7919);
+            pHashes[i] = KeyFuncs<String>().Hash(key);
+        }
+        VERIFY(HashCollisionRatio(pHashes, count) < 1.1);
+        VERIFY(KeyFuncs<const char*>().Hash("Ducks") == KeyFuncs<String>().Hash("Ducks"));
+        String nullByte;
+        nullByte.pData = (char*)"\0";
+        nullByte.length = 1;
+        VERIFY(KeyFuncs<String>().Hash("") != KeyFuncs<String>().Hash(nullByte));
+
+        // Avalanche
+        VERIFY(HashAvalancheBias(HashIntBytes, 8) < 0.05);
+        i64 lengths[] = { 3, 8, 13, 16, 24, 49 };
+        for (i64 length : lengths) {
+            VERIFY(HashAvalancheBias(HashStringBytes, length) < 0.05);
+        }
+    }
+    EndTest(errorCount);
+}
+
 void StringTest() {
     StartTest("String Test");
     int errorCount = 0;
@@ -249,6 +688,10 @@ void StringTest() {
         VERIFY(builtString != "Ducks");
         VERIFY(builtString.length == 48);
 
+        // every argument has to be stepped past with its own type, or whatever comes after a double or 64 bit value is garbage
+        String formatted = StringPrint(pArena, "%i %.2f %lli %s %*i %S %c 100%% %g %zu", -3, 2.5, 1099511627776ll, "str", 4, 7, String("sub"), 'x', 0.125, (size_t)42);
+        VERIFY(formatted == "-3 2.50 1099511627776 str    7 sub x 100% 0.125 42");
+
 		ArenaFinished(pArena);
     }
 
@@ -363,6 +806,638 @@ void ArenaTest() {
         }
 
         ArenaFinished(pArena);
+
+        // Huge page backed arenas commit in huge page steps, but otherwise behave the same
+        Arena* pHugeArena = ArenaCreate(DEFAULT_RESERVE, false, AF_HUGE_PAGES);
+        VERIFY(pHugeArena->pageSize == VirtualHugePageSize());
+        VERIFY(((u64)pHugeArena & (pHugeArena->pageSize - 1)) == 0);
+
+        i64* pBig = New(pHugeArena, i64, 1000000);
+        pBig[999999] = 1337;
+        i64* pSmall = New(pHugeArena, i64);
+        VERIFY(pBig[999999] == 1337);
+        VERIFY(*pSmall == 0);
+        VERIFY(((pHugeArena->pFirstUncommittedPage - (u8*)pHugeArena) % pHugeArena->pageSize) == 0);
+        ArenaFinished(pHugeArena);
+
+        // Retention policy gives back pages above the recent high water mark on reset
+        Arena* pFrameArena = ArenaCreate();
+        ArenaSetRetention(pFrameArena, 0, 2);
+        New(pFrameArena, u8, 1024 * 1024);
+        ArenaReset(pFrameArena);
+        i64 decommits = pFrameArena->stats.decommitCount;
+        New(pFrameArena, u8, 1024);
+        ArenaReset(pFrameArena);
+        VERIFY(pFrameArena->stats.decommitCount == decommits); // spike is still inside the window
+        VERIFY(pFrameArena->pFirstUncommittedPage - pFrameArena->pMemoryBase >= 1024 * 1024);
+        New(pFrameArena, u8, 1024);
+        ArenaReset(pFrameArena);
+        VERIFY(pFrameArena->stats.decommitCount == decommits + 1);
+        VERIFY(pFrameArena->pFirstUncommittedPage - pFrameArena->pMemoryBase < 2 * pFrameArena->pageSize);
+        VERIFY(pFrameArena->stats.bytesDecommitted >= 1024 * 1024 - 2 * pFrameArena->pageSize);
+
+        // Recommitted pages come back zeroed and usable
+        u8* pBytes = New(pFrameArena, u8, 1024 * 1024);
+        VERIFY(pBytes[1024 * 1024 - 1] == 0);
+        ArenaFinished(pFrameArena);
+
+        // Temporary regions roll the head back when they end
+        Arena* pTempArena = ArenaCreate();
+        New(pTempArena, int);
+        u8* pHeadBefore = pTempArena->pCurrentHead;
+        {
+            ArenaTempScope(temp, pTempArena);
+            New(pTempArena, int, 1000);
+            VERIFY(pTempArena->pCurrentHead > pHeadBefore);
+        }
+        VERIFY(pTempArena->pCurrentHead == pHeadBefore);
+
+        // Scratch arenas never hand back the arena you're allocating your results in
+        ArenaTemp scratch1 = ScratchBegin();
+        ArenaTemp scratch2 = ScratchBegin(scratch1.pArena);
+        VERIFY(scratch1.pArena != scratch2.pArena);
+        VERIFY(scratch2.pArena != pTempArena);
+        u8* pScratch1Head = scratch1.pArena->pCurrentHead;
+        ResizableArray<String> parts = Split(scratch2.pArena, "a/b/c", "/");
+        VERIFY(parts.count == 3 && parts[2] == "c");
+        VERIFY(scratch1.pArena->pCurrentHead == pScratch1Head);
+        ScratchEnd(scratch2);
+        ScratchEnd(scratch1);
+        ArenaFinished(pTempArena);
+
+        // Big arrays that can't grow at the head move once to their own reservation, then grow without copies
+        Arena* pLargeArena = ArenaCreate();
+        ResizableArray<i32> bigArray(pLargeArena);
+        ResizableArray<i32> smallArray(pLargeArena);
+        bigArray.Reserve(1024);
+        smallArray.PushBack(1);
+        for (i32 i = 0; i < 4 * 1024 * 1024; i++) {
+            bigArray.PushBack(i);
+            if (i % 4096 == 0)
+                smallArray.PushBack(i); // keeps the big array from ever being at the head
+        }
+        VERIFY(pLargeArena->pLargeBlocks != nullptr);
+        VERIFY(pLargeArena->pLargeBlocks->pData == (u8*)bigArray.pData);
+        VERIFY(pLargeArena->pLargeBlocks->pNext == nullptr);
+        VERIFY(bigArray[0] == 0 && bigArray[4 * 1024 * 1024 - 1] == 4 * 1024 * 1024 - 1);
+        VERIFY(pLargeArena->stats.bytesAbandoned < ARENA_LARGE_BLOCK_SIZE + smallArray.capacity * (i64)sizeof(i32));
+        ArenaReset(pLargeArena);
+        VERIFY(pLargeArena->pLargeBlocks == nullptr);
+
+        // Large blocks made inside a temp region go when it ends, ones from before it stay
+        void* pOuterBlock = ArenaAllocReleasable(pLargeArena, 2 * ARENA_LARGE_BLOCK_SIZE, 16);
+        VERIFY(ArenaFindLargeBlock(pLargeArena, pOuterBlock) == pLargeArena->pLargeBlocks);
+        VERIFY(ArenaFindLargeBlock(pLargeArena, New(pLargeArena, i32)) == nullptr);
+        ArenaTemp largeTemp = ArenaTempBegin(pLargeArena);
+        ArenaAllocReleasable(pLargeArena, 2 * ARENA_LARGE_BLOCK_SIZE, 16);
+        ResizableArray<i32> tempArray(pLargeArena);
+        for (i32 i = 0; i < 1024 * 1024; i++) {
+            tempArray.PushBack(i);
+            if (i % 4096 == 0)
+                New(pLargeArena, i32);
+        }
+        VERIFY(pLargeArena->pLargeBlocks->pData == (u8*)tempArray.pData);
+        ArenaTempEnd(largeTemp);
+        VERIFY(pLargeArena->pLargeBlocks != nullptr && pLargeArena->pLargeBlocks->pData == pOuterBlock);
+        VERIFY(pLargeArena->pLargeBlocks->pNext == nullptr && pLargeArena->pLargeBlocks->pPrev == nullptr);
+        ArenaFinished(pLargeArena);
+    }
+    {
+        // Chained arenas link more reservations in rather than running out
+        Arena* pChainArena = ArenaCreate(64 * 1024, false, AF_CHAINED);
+        i64* pFirst = New(pChainArena, i64);
+        *pFirst = 1234;
+
+        ArenaTemp temp = ArenaTempBegin(pChainArena);
+        i64* pBlocks[64];
+        for (i64 i = 0; i < 64; i++) {
+            pBlocks[i] = New(pChainArena, i64, 512);
+            pBlocks[i][511] = i;
+        }
+        u8* pHuge = New(pChainArena, u8, 256 * 1024); // bigger than a whole chunk
+        pHuge[256 * 1024 - 1] = 1;
+        VERIFY(pChainArena->pChunks != nullptr);
+        VERIFY(ArenaUsedBytes(pChainArena) >= 64 * 4096 + 256 * 1024);
+        VERIFY(ArenaCommittedBytes(pChainArena) >= ArenaUsedBytes(pChainArena));
+
+        bool allValid = true;
+        for (i64 i = 0; i < 64; i++) {
+            allValid &= pBlocks[i][511] == i;
+        }
+        VERIFY(allValid);
+
+        i64 usedInTemp = ArenaUsedBytes(pChainArena);
+        ArenaTempEnd(temp);
+        VERIFY(pChainArena->pChunks == nullptr);
+        VERIFY(ArenaUsedBytes(pChainArena) == sizeof(i64) + ARENA_REDZONE);
+        VERIFY(pChainArena->stats.peakUsed == usedInTemp); // the chunks it grew into count, even though they're gone
+        VERIFY(*pFirst == 1234);
+
+        for (i64 i = 0; i < 64; i++) {
+            New(pChainArena, i64, 512);
+        }
+        ArenaReset(pChainArena);
+        VERIFY(pChainArena->pChunks == nullptr);
+        VERIFY(ArenaUsedBytes(pChainArena) == 0);
+        ArenaFinished(pChainArena);
+    }
+    {
+        // Zeroing is skipped for fresh pages, but recycled memory must still come back zeroed
+        Arena* pZeroArena = ArenaCreate();
+        u8* pDirty = New(pZeroArena, u8, 8192);
+        memset(pDirty, 0xff, 8192);
+        ArenaReset(pZeroArena);
+
+        u8* pRecycled = New(pZeroArena, u8, 16384);
+        bool allZero = true;
+        for (i64 i = 0; i < 16384; i++) {
+            allZero &= pRecycled[i] == 0;
+        }
+        VERIFY(allZero);
+
+        ArenaTemp temp = ArenaTempBegin(pZeroArena);
+        memset(New(pZeroArena, u8, 100, true), 0xff, 100);
+        ArenaTempEnd(temp);
+        ResizableArray<u8> array(pZeroArena);
+        array.Resize(100);
+        allZero = true;
+        for (i64 i = 0; i < 100; i++) {
+            allZero &= array[i] == 0;
+        }
+        VERIFY(allZero);
+        ArenaFinished(pZeroArena);
+    }
+    {
+        // Guard page arenas push every allocation up against an uncommitted page
+        Arena* pGuardArena = ArenaCreate(DEFAULT_RESERVE, false, AF_GUARD_PAGES);
+        i64 pageSize = pGuardArena->pageSize;
+        i64 committedBefore = ArenaCommittedBytes(pGuardArena);
+        ArenaTemp temp = ArenaTempBegin(pGuardArena);
+        u8* pBytes = New(pGuardArena, u8, 100);
+        i64* pInts = New(pGuardArena, i64, 3);
+        VERIFY(Align(u64(pBytes + 100), pageSize) == u64(pBytes + 100));
+        VERIFY(Align(u64(pInts + 3), pageSize) == u64(pInts + 3));
+        VERIFY((u8*)pInts - (pBytes + 100) >= pageSize);
+        VERIFY(pBytes[0] == 0 && pInts[2] == 0);
+        pBytes[99] = 1;
+        pInts[2] = 1;
+
+        u8* pOddAligned = (u8*)ArenaAlloc(pGuardArena, 13, 64);
+        VERIFY(u64(pOddAligned) % 64 == 0);
+        VERIFY(Align(u64(pOddAligned + 13), pageSize) - u64(pOddAligned + 13) < 64);
+
+        // one page each, the guard pages between them are never committed
+        VERIFY(ArenaCommittedBytes(pGuardArena) == committedBefore + 3 * pageSize);
+        VERIFY(pGuardArena->stats.commitCount == 3);
+
+        // Everything after the temp start is decommitted again, so stale pointers fault
+        u8* pCommittedEnd = pGuardArena->pFirstUncommittedPage;
+        ArenaTempEnd(temp);
+        VERIFY(pGuardArena->pFirstUncommittedPage < pCommittedEnd);
+        VERIFY(pGuardArena->pFirstUncommittedPage <= pBytes);
+        VERIFY(ArenaCommittedBytes(pGuardArena) == committedBefore);
+
+        ResizableArray<i32> array(pGuardArena);
+        for (i32 i = 0; i < 5000; i++) {
+            array.PushBack(i);
+        }
+        VERIFY(array[4999] == 4999);
+        ArenaTemp nested = ArenaTempBegin(pGuardArena);
+        New(pGuardArena, u8, 10);
+        New(pGuardArena, u8, 10);
+        i64 committedNested = ArenaCommittedBytes(pGuardArena);
+        ArenaTempEnd(nested);
+        VERIFY(ArenaCommittedBytes(pGuardArena) == committedNested - 2 * pageSize);
+        ArenaReset(pGuardArena);
+        VERIFY(ArenaCommittedBytes(pGuardArena) == committedBefore);
+        VERIFY(pGuardArena->pFirstUncommittedPage <= AlignPtr(pGuardArena->pMemoryBase, pageSize));
+        ArenaFinished(pGuardArena);
+    }
+    {
+        // Telemetry and the live arena list
+        Arena* pStatsArena = ArenaCreate();
+        ArenaSetName(pStatsArena, "Stats Test");
+        New(pStatsArena, u8, 3);
+        New(pStatsArena, u64, 4);
+        VERIFY(ArenaUsedBytes(pStatsArena) == 40 + 2 * ARENA_REDZONE);
+        VERIFY(ArenaCommittedBytes(pStatsArena) >= pStatsArena->pageSize);
+        ArenaReset(pStatsArena);
+
+        ArenaStats stats = ArenaGetStats(pStatsArena);
+        VERIFY(stats.peakUsed == 40 + 2 * ARENA_REDZONE);
+        VERIFY(stats.resetCount == 1);
+#ifdef ARENA_STATS
+        VERIFY(stats.allocationCount == 2);
+        VERIFY(stats.bytesRequested == 35);
+        VERIFY(stats.bytesAlignmentWaste == 5);
+#endif
+
+        struct FindArena { Arena* pTarget; bool found; };
+        FindArena find = { pStatsArena, false };
+        ArenaForEach([](Arena* pArena, void* pUserData) {
+            FindArena* pFind = (FindArena*)pUserData;
+            if (pArena == pFind->pTarget)
+                pFind->found = true;
+        }, &find);
+        VERIFY(find.found);
+
+        ArenaFinished(pStatsArena);
+        find.found = false;
+        ArenaForEach([](Arena* pArena, void* pUserData) {
+            FindArena* pFind = (FindArena*)pUserData;
+            if (pArena == pFind->pTarget)
+                pFind->found = true;
+        }, &find);
+        VERIFY(!find.found);
+    }
+    errorCount += ReportMemoryLeaks();
+    EndTest(errorCount);
+}
+
+struct PoolTestNode {
+    PoolTestNode* pNext;
+    i64 value;
+    char padding[40];
+};
+
+void PoolTest() {
+    StartTest("Pool Test");
+    int errorCount = 0;
+    {
+		Arena* pArena = ArenaCreate();
+        Pool<PoolTestNode> pool(pArena, 16);
+
+        PoolTestNode* nodes[100];
+        for (int i = 0; i < 100; i++) {
+            nodes[i] = pool.Alloc();
+            VERIFY(nodes[i]->value == 0);
+            nodes[i]->value = i;
+        }
+        VERIFY(pool.Count() == 100);
+        VERIFY(nodes[99]->value == 99);
+
+        // Freed slots get reused before the arena grows again
+        u8* pHeadBefore = pArena->pCurrentHead;
+        pool.Free(nodes[10]);
+        pool.Free(nodes[20]);
+        VERIFY(pool.Count() == 98);
+        PoolTestNode* pReused1 = pool.Alloc();
+        PoolTestNode* pReused2 = pool.Alloc();
+        VERIFY(pReused1 == nodes[20]);
+        VERIFY(pReused2 == nodes[10]);
+        VERIFY(pReused1->value == 0);
+        VERIFY(pArena->pCurrentHead == pHeadBefore);
+
+        // Reset hands back every slot, and the same blocks get used again
+        pool.Reset();
+        VERIFY(pool.Count() == 0);
+        for (int i = 0; i < 100; i++) {
+            pool.Alloc();
+        }
+        VERIFY(pArena->pCurrentHead == pHeadBefore);
+
+        // Untyped slabs round small slots up so they can hold the free list link, and respect alignment
+        SlabAllocator slab(pArena, 3, 32);
+        VERIFY(slab.slotSize == 32);
+        void* pA = slab.Alloc();
+        void* pB = slab.Alloc();
+        VERIFY(((u64)pA & 31) == 0 && ((u64)pB & 31) == 0);
+        VERIFY((u8*)pB - (u8*)pA == 32);
+        slab.Free(pA);
+        VERIFY(slab.Alloc() == pA);
+
+		ArenaFinished(pArena);
+    }
+    errorCount += ReportMemoryLeaks();
+    EndTest(errorCount);
+}
+
+THREAD_PROC(RawAllocTestThread) {
+    // Free half of what the main thread allocated, and churn our own allocations
+    void** ptrs = (void**)pParam;
+    for (int i = 0; i < 500; i++) {
+        RawFree(ptrs[i]);
+    }
+    for (int i = 0; i < 10000; i++) {
+        void* p = RawAlloc(8 + i % 300);
+        RawFree(p);
+    }
+    HeapThreadCacheFlush();
+    return 0;
+}
+
+void RawAllocTest() {
+    StartTest("Raw Alloc Test");
+    int errorCount = 0;
+    {
+        // Small allocations get rounded up to size classes but are zeroed to the size asked for
+        u8* pSmall = RawNew(u8, 20);
+        VERIFY(((u64)pSmall & 15) == 0);
+        VERIFY(pSmall[19] == 0);
+        memset(pSmall, 0xab, 20);
+
+        // Growing within the size class keeps the same block, growing out of it copies
+        u8* pGrown = (u8*)RawRealloc(pSmall, 32, 20);
+        VERIFY(pGrown == pSmall);
+        VERIFY(pGrown[19] == 0xab && pGrown[31] == 0);
+        pGrown = (u8*)RawRealloc(pGrown, 1000, 32);
+        VERIFY(pGrown[0] == 0xab && pGrown[999] == 0);
+
+        // Freed blocks are reused straight away
+        RawFree(pGrown);
+        u8* pReused = RawNew(u8, 1000);
+        VERIFY(pReused == pGrown);
+        VERIFY(pReused[0] == 0);
+        RawFree(pReused);
+
+        // Large allocations bypass the size classes
+        i64* pLarge = RawNew(i64, 100000);
+        pLarge[99999] = 1337;
+        pLarge = (i64*)RawRealloc(pLarge, sizeof(i64) * 200000, sizeof(i64) * 100000);
+        VERIFY(pLarge[99999] == 1337 && pLarge[199999] == 0);
+        RawFree(pLarge);
+
+        // Blocks can be freed on a different thread to the one that allocated them
+        void* ptrs[1000];
+        for (int i = 0; i < 1000; i++) {
+            ptrs[i] = RawAlloc(8 + i % 300);
+            memset(ptrs[i], i & 0xff, 8 + i % 300);
+        }
+        TestThread thread = StartThread(RawAllocTestThread, ptrs);
+        JoinThreads(&thread, 1);
+
+        int corrupt = 0;
+        for (int i = 500; i < 1000; i++) {
+            if (((u8*)ptrs[i])[7 + i % 300] != (i & 0xff))
+                corrupt++;
+            RawFree(ptrs[i]);
+        }
+        VERIFY(corrupt == 0);
+    }
+    errorCount += ReportMemoryLeaks();
+    EndTest(errorCount);
+}
+
+struct MemoryTrackerTestData {
+    u8* pAddresses;
+    volatile i64 slots[1024];
+    volatile i64 nextSlot;
+};
+
+THREAD_PROC(MemoryTrackerTestThread) {
+    MemoryTrackerTestData* pData = (MemoryTrackerTestData*)pParam;
+    i64 heldSlot = -1;
+    for (int i = 0; i < 50000; i++) {
+        i64 slot = AtomicAdd(&pData->nextSlot, 1) % 1024;
+        if (AtomicCompareExchange(&pData->slots[slot], 0, 1)) {
+            CheckMalloc(pData->pAddresses + slot * 64, 64);
+            if (heldSlot >= 0) {
+                CheckFree(pData->pAddresses + heldSlot * 64);
+                AtomicStore(&pData->slots[heldSlot], 0);
+            }
+            heldSlot = slot;
+        }
+    }
+    MemoryTrackingThreadRelease();
+    return 0;
+}
+
+i64 CountTrackerThreads() {
+    i64 count = 0;
+    for (TrackerThread* pThread = g_pTrackerThreads; pThread; pThread = pThread->pNext)
+        count++;
+    return count;
+}
+
+void MemoryTrackerTest() {
+    StartTest("Memory Tracker Test");
+    int errorCount = 0;
+    {
+        // Allocations from one callsite share a single interned trace, and frees drop the record entirely
+        u8* pAddresses = VirtualReserve(1000 * 64);
+        CheckMalloc(pAddresses, 8);
+        FlushMemoryTracking(); // makes sure the tracker exists
+        i64 tracesBefore = pMemTrack->traces.count;
+        i64 recordsBefore = pMemTrack->allocationTable.count;
+        for (i64 i = 1; i < 1000; i++) {
+            CheckMalloc(pAddresses + i * 64, 8);
+        }
+        FlushMemoryTracking();
+        VERIFY(pMemTrack->traces.count - tracesBefore <= 1);
+        VERIFY(pMemTrack->allocationTable.count == recordsBefore + 999);
+        VERIFY(sizeof(Allocation) <= 40);
+
+        for (i64 i = 0; i < 1000; i++) {
+            CheckFree(pAddresses + i * 64);
+        }
+        FlushMemoryTracking();
+        VERIFY(pMemTrack->allocationTable.count == recordsBefore - 1);
+        VERIFY(pMemTrack->freedHistory[(pMemTrack->freedCount - 1) % FREED_HISTORY_SIZE].pointer == pAddresses + 999 * 64);
+        VirtualRelease(pAddresses, 1000 * 64);
+    }
+    {
+        // Addresses only, the tracker never touches the memory
+        const i64 allocationCount = 20000;
+        u8* pAddresses = VirtualReserve(allocationCount * 1024);
+        i64 usageBefore = GetTrackedMemoryUsage();
+
+        SetMemoryTrackingSampleRate(4096);
+        i64 trueBytes = 0;
+        srand(3);
+        for (i64 i = 0; i < allocationCount; i++) {
+            i64 size = 16 + rand() % 1008;
+            CheckMalloc(pAddresses + i * 1024, size);
+            trueBytes += size;
+        }
+        i64 estimate = GetTrackedMemoryUsage() - usageBefore;
+        VERIFY(estimate > trueBytes * 9 / 10 && estimate < trueBytes * 11 / 10);
+
+        // free half, the estimate should follow
+        for (i64 i = 0; i < allocationCount; i += 2) {
+            CheckFree(pAddresses + i * 1024);
+        }
+        estimate = GetTrackedMemoryUsage() - usageBefore;
+        VERIFY(estimate > trueBytes * 4 / 10 && estimate < trueBytes * 6 / 10);
+
+        for (i64 i = 1; i < allocationCount; i += 2) {
+            CheckFree(pAddresses + i * 1024);
+        }
+        VERIFY(GetTrackedMemoryUsage() == usageBefore);
+        SetMemoryTrackingSampleRate(MEMORY_TRACKING_SAMPLE_RATE);
+        VirtualRelease(pAddresses, allocationCount * 1024);
+    }
+    {
+        // Threads hand a small pool of addresses between each other, so the tracker has to replay every
+        // free before the next thread's malloc of the same address or it would report bogus frees
+        MemoryTrackerTestData data = {};
+        data.pAddresses = VirtualReserve(1024 * 64);
+        FlushMemoryTracking();
+        i64 recordsBefore = pMemTrack->allocationTable.count;
+        i64 trackerThreadsBefore = CountTrackerThreads();
+
+        const int threadCount = 8;
+        TestThread threads[threadCount];
+        for (int i = 0; i < threadCount; i++) {
+            threads[i] = StartThread(MemoryTrackerTestThread, &data);
+        }
+        JoinThreads(threads, threadCount);
+
+        // every thread leaves one slot it took last allocated, and the threads themselves are gone once merged
+        FlushMemoryTracking();
+        VERIFY(pMemTrack->allocationTable.count == recordsBefore + threadCount);
+        VERIFY(CountTrackerThreads() == trackerThreadsBefore);
+        for (i64 i = 0; i < 1024; i++) {
+            if (data.slots[i])
+                CheckFree(data.pAddresses + i * 64);
+        }
+        FlushMemoryTracking();
+        VERIFY(pMemTrack->allocationTable.count == recordsBefore);
+        VirtualRelease(data.pAddresses, 1024 * 64);
+    }
+    {
+        // Profiles total live memory per callsite, and diffing two shows only what changed in between
+        Arena* pArena = ArenaCreate();
+        u8* pAddresses = VirtualReserve(10 * 128);
+        HeapProfile before = TakeHeapProfile(pArena);
+        for (i64 i = 0; i < 10; i++) {
+            CheckMalloc(pAddresses + i * 128, 100);
+        }
+        HeapProfile after = TakeHeapProfile(pArena);
+        VERIFY(after.totalCount == before.totalCount + 10);
+        VERIFY(after.totalBytes == before.totalBytes + 1000);
+
+        HeapProfile diff = DiffHeapProfiles(before, after, pArena);
+        VERIFY(diff.entries.count == 1);
+        VERIFY(diff.entries[0].count == 10);
+        VERIFY(diff.entries[0].bytes == 1000);
+
+        String collapsed = HeapProfileToCollapsedStacks(diff, pArena);
+        VERIFY(EndsWith(collapsed, " 1000\n"));
+        String pprof = HeapProfileToPprof(diff, pArena);
+        VERIFY(pprof.length > 0 && pprof[0] == 0x0a); // starts with the sample_type field
+
+        for (i64 i = 0; i < 10; i++) {
+            CheckFree(pAddresses + i * 128);
+        }
+        HeapProfile afterFree = TakeHeapProfile(pArena);
+        diff = DiffHeapProfiles(before, afterFree, pArena);
+        VERIFY(diff.entries.count == 0 && diff.totalBytes == 0);
+        VirtualRelease(pAddresses, 10 * 128);
+        ArenaFinished(pArena);
+    }
+    EndTest(errorCount);
+}
+
+void DebugTest() {
+    StartTest("Debug Test");
+    int errorCount = 0;
+    {
+        Arena* pArena = ArenaCreate();
+        void* frames[64];
+        u64 frameCount = Debug::CollectStackTrace(frames, 64);
+        VERIFY(frameCount > 1);
+
+        // The first frame is a return address in this function, it takes frames as they come
+        String name = Debug::SymbolizeAddress(frames[0], pArena);
+        VERIFY(Find(name, "DebugTest") < name.length);
+
+        String trace = Debug::PrintStackTraceToString(frames, frameCount, pArena);
+        VERIFY(Find(trace, "tests_main.cpp") < trace.length);
+
+        // Resolved addresses are cached, the second time round has to give the same answer
+        String trace2 = Debug::PrintStackTraceToString(frames, frameCount, pArena);
+        VERIFY(trace == trace2);
+
+        // Warming the cache up front changes nothing about the output
+        void* moreFrames[64];
+        u64 moreFrameCount = Debug::CollectStackTrace(moreFrames, 64);
+        Debug::SymbolizeStackFrames(moreFrames, moreFrameCount);
+        String warmTrace = Debug::PrintStackTraceToString(moreFrames, moreFrameCount, pArena);
+        VERIFY(Find(warmTrace, "DebugTest") < warmTrace.length);
+
+        // Raw traces are module+offset per frame, and each frame's module is in the module map
+        String raw = Debug::PrintStackTraceRaw(frames, frameCount, pArena);
+        String moduleMap = Debug::GetModuleMap(pArena);
+        i64 plus = Find(raw, "+0x");
+        VERIFY(plus < raw.length);
+        i64 pathStart = Find(raw, " ") + 1;
+        pathStart += Find(SubStr(raw, pathStart), " ") + 1;
+        VERIFY(Find(moduleMap, SubStr(raw, pathStart, plus - pathStart)) < moduleMap.length);
+        ArenaFinished(pArena);
+    }
+    EndTest(errorCount);
+}
+
+struct ConcurrentArenaTestData {
+    Arena* pArena;
+    u8 threadId;
+    ResizableArray<u8*> blocks;
+    ResizableArray<i64> sizes;
+};
+
+THREAD_PROC(ConcurrentArenaTestThread) {
+    ConcurrentArenaTestData* pData = (ConcurrentArenaTestData*)pParam;
+    u64 seed = pData->threadId + 1;
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        i64 size = 1 + (seed >> 33) % 200;
+        i64 align = i64(1) << ((seed >> 20) % 7);
+        u8* pBlock = (u8*)ArenaAlloc(pData->pArena, size, align);
+        memset(pBlock, pData->threadId, size);
+        pData->blocks.PushBack(pBlock);
+        pData->sizes.PushBack(size);
+    }
+    return 0;
+}
+
+void ConcurrentArenaTest() {
+    StartTest("Concurrent Arena Test");
+    int errorCount = 0;
+    {
+		Arena* pArena = ArenaCreate();
+        Arena* pShared = ArenaCreate(DEFAULT_RESERVE, false, AF_CONCURRENT);
+
+        // Every thread fills its own blocks with its id, if any two blocks overlapped we'd see another thread's id
+        const int threadCount = 8;
+        ConcurrentArenaTestData data[threadCount];
+        TestThread threads[threadCount];
+        for (int i = 0; i < threadCount; i++) {
+            data[i].pArena = pShared;
+            data[i].threadId = u8(i + 1);
+            data[i].blocks = ResizableArray<u8*>(pArena);
+            data[i].sizes = ResizableArray<i64>(pArena);
+            data[i].blocks.Reserve(20000); // pArena itself isn't concurrent, so no growing on the threads
+            data[i].sizes.Reserve(20000);
+        }
+        for (int i = 0; i < threadCount; i++) {
+            threads[i] = StartThread(ConcurrentArenaTestThread, &data[i]);
+        }
+        JoinThreads(threads, threadCount);
+
+        int corruptBlocks = 0;
+        for (int i = 0; i < threadCount; i++) {
+            for (i64 j = 0; j < data[i].blocks.count; j++) {
+                u8* pBlock = data[i].blocks[j];
+                if (pBlock + data[i].sizes[j] > pShared->pCurrentHead || pBlock + data[i].sizes[j] > pShared->pFirstUncommittedPage)
+                    corruptBlocks++;
+                for (i64 k = 0; k < data[i].sizes[j]; k++) {
+                    if (pBlock[k] != data[i].threadId) {
+                        corruptBlocks++;
+                        break;
+                    }
+                }
+            }
+        }
+        VERIFY(corruptBlocks == 0);
+
+        // Growing the block at the head still happens in place
+        ArenaReset(pShared);
+        u8* pBlock = (u8*)ArenaAlloc(pShared, 8, 8);
+        VERIFY(ArenaRealloc(pShared, pBlock, 64, 8, 8) == pBlock);
+        VERIFY(pShared->pCurrentHead == pBlock + 64);
+
+        ArenaFinished(pShared);
+		ArenaFinished(pArena);
     }
     errorCount += ReportMemoryLeaks();
     EndTest(errorCount);
@@ -545,6 +1620,276 @@ void LogTest() {
     EndTest(errorCount);
 }
 
+static i64 g_asyncLogCount;
+static i64 g_asyncLogLast[4];
+static i64 g_asyncLogOutOfOrder;
+
+void AsyncLogCountingHandler(Log::LogLevel level, String message) {
+    int thread, index;
+    if (sscanf(message.pData, "[INFO] async %i %i", &thread, &index) == 2) {
+        if (index != g_asyncLogLast[thread] + 1)
+            g_asyncLogOutOfOrder++;
+        g_asyncLogLast[thread] = index;
+        g_asyncLogCount++;
+    }
+}
+
+THREAD_PROC(AsyncLogTestThread) {
+    int thread = (int)(i64)pParam;
+    for (int i = 0; i < 5000; i++) {
+        Log::Info("async %i %i", thread, i);
+    }
+    Log::ThreadRingRelease();
+    ScratchArenasRelease();
+    return 0;
+}
+
+i64 CountLogRings() {
+    i64 count = 0;
+    for (Log::LogRing* pRing = Log::g_pLogRings; pRing; pRing = pRing->pNext)
+        count++;
+    return count;
+}
+
+static int g_reentrantCritCount = 0;
+
+void ReentrantCritHandler(Log::LogLevel level, String message) {
+    // runs inside the drain, so this crit can't be allowed to wait on a flush
+    if (g_reentrantCritCount++ == 0)
+        Log::Crit("crit from inside a drain");
+}
+
+static i64 g_echoBlocked = 0;
+static i64 g_echoEchoes = 0;
+static i64 g_echoUnexpected = 0;
+
+void EchoLogHandler(Log::LogLevel level, String message) {
+    // logs again from inside the drain, into a ring that may well still be full
+    int index;
+    if (sscanf(message.pData, "[INFO] blocked %i", &index) == 1) {
+        if (index != g_echoBlocked)
+            g_echoUnexpected++;
+        g_echoBlocked++;
+        Log::Info("echo %i", index);
+    } else if (sscanf(message.pData, "[INFO] echo %i", &index) == 1) {
+        g_echoEchoes++;
+    } else {
+        g_echoUnexpected++;
+    }
+}
+
+void AsyncLogTest() {
+    StartTest("Async Log Test");
+    int errorCount = 0;
+    {
+        // Small rings so they fill up and the threads have to block
+        Log::LogConfig cfg;
+        cfg.winOutput = false;
+        cfg.consoleOutput = false;
+        cfg.fileOutput = false;
+        cfg.customHandler1 = AsyncLogCountingHandler;
+        cfg.asyncOutput = true;
+        cfg.asyncBufferSize = 4096;
+        cfg.asyncOverflow = Log::EBlock;
+        Log::SetConfig(cfg);
+        for (int i = 0; i < 4; i++) {
+            g_asyncLogLast[i] = -1;
+        }
+
+        i64 ringsBefore = CountLogRings();
+        TestThread threads[4];
+        for (int i = 0; i < 4; i++) {
+            threads[i] = StartThread(AsyncLogTestThread, (void*)(i64)i);
+        }
+        JoinThreads(threads, 4);
+        VERIFY(CountLogRings() == ringsBefore); // each thread wrote out and gave back its ring on the way out
+        Log::Flush();
+        VERIFY(g_asyncLogCount == 20000);
+        VERIFY(g_asyncLogOutOfOrder == 0);
+
+        // When dropping, whatever doesn't fit just doesn't get written
+        cfg.asyncOverflow = Log::EDropMessage;
+        Log::SetConfig(cfg);
+        g_asyncLogCount = 0;
+        g_asyncLogLast[0] = -1;
+        for (int i = 0; i < 20000; i++) {
+            Log::Info("async %i %i", 0, i);
+        }
+        Log::Flush();
+        VERIFY(g_asyncLogCount > 0 && g_asyncLogCount <= 20000);
+
+        // Crits and asserts flush first, which must not deadlock when they come from inside a drain
+        cfg.customHandler1 = ReentrantCritHandler;
+        cfg.critCrashes = false;
+        cfg.symbolizeCritTraces = false;
+        Log::SetConfig(cfg);
+        Log::Info("trigger");
+        Log::Flush();
+        VERIFY(g_reentrantCritCount >= 2); // the trigger message, then the crit itself
+
+        // A handler that logs while a blocked thread is draining can't wait itself, its message is dropped if there's
+        // no room, and anything it did write must not be trampled by the record the blocked thread goes on to write
+        cfg.customHandler1 = EchoLogHandler;
+        cfg.asyncOverflow = Log::EBlock;
+        Log::SetConfig(cfg);
+        for (int i = 0; i < 2000; i++) {
+            Log::Info("blocked %i", i);
+        }
+        Log::Flush();
+        Log::Flush(); // echoes from the last drain
+        VERIFY(g_echoBlocked == 2000);
+        VERIFY(g_echoEchoes > 0 && g_echoEchoes <= 2000);
+        VERIFY(g_echoUnexpected == 0);
+
+        Log::SetConfig(Log::LogConfig());
+    }
+    EndTest(errorCount);
+}
+
+static char g_binaryLogLast[256];
+
+void BinaryLogHandler(Log::LogLevel level, String message) {
+    i64 length = message.length < 255 ? message.length : 255;
+    memcpy(g_binaryLogLast, message.pData, length);
+    g_binaryLogLast[length] = 0;
+}
+
+void BinaryLogTest() {
+    StartTest("Binary Log Test");
+    int errorCount = 0;
+    {
+        Log::LogConfig cfg;
+        cfg.winOutput = false;
+        cfg.consoleOutput = false;
+        cfg.binaryOutput = true;
+        cfg.customHandler1 = BinaryLogHandler;
+        Log::SetConfig(cfg);
+
+        // the handler sees the live decoded text
+        String name = "some string";
+        Log::Info("ints %i %lli %u %x %05d %hhu", -12, 1ll << 40, 4000000000u, 255, 42, 300);
+        Log::Flush();
+        VERIFY(strcmp(g_binaryLogLast, "[INFO] ints -12 1099511627776 4000000000 ff 00042 44\n") == 0);
+        Log::Warn("floats %.2f %8.3e %g", 3.14159, 12345.678, 0.5);
+        Log::Flush();
+        VERIFY(strcmp(g_binaryLogLast, "[WARNING] floats 3.14 1.235e+04 0.5\n") == 0);
+        Log::Debug("strings %s|%-6s|%.3s|%*.*s|%S %c 100%%", "hello", "ab", "truncated", 6, 2, "xyz", name, 'Z');
+        Log::Flush();
+        VERIFY(strcmp(g_binaryLogLast, "[DEBUG] strings hello|ab    |tru|    xy|some string Z 100%\n") == 0);
+
+        // a string that's gone by the time it's written out still comes through, it was copied
+        char temporary[16];
+        strcpy(temporary, "temporary");
+        Log::Info("copied %s", temporary);
+        strcpy(temporary, "overwritten");
+        Log::Flush();
+        VERIFY(strcmp(g_binaryLogLast, "[INFO] copied temporary\n") == 0);
+
+        // The file decodes back to the same text, the repeated format only goes in the file once
+        for (int i = 0; i < 3; i++) {
+            Log::Info("repeat %i", i);
+        }
+        Log::SetConfig(Log::LogConfig());
+
+        FILE* pFile = fopen("application.binlog", "rb");
+        VERIFY(pFile != nullptr);
+        if (pFile) {
+            String contents = AllocString(1 << 16, g_pArenaFrame);
+            contents.length = fread(contents.pData, 1, contents.length, pFile);
+            fclose(pFile);
+
+            String decoded = Log::DecodeBinaryLog(contents, g_pArenaFrame, false);
+            VERIFY(decoded == String(
+                "[INFO] ints -12 1099511627776 4000000000 ff 00042 44\n"
+                "[WARNING] floats 3.14 1.235e+04 0.5\n"
+                "[DEBUG] strings hello|ab    |tru|    xy|some string Z 100%\n"
+                "[INFO] copied temporary\n"
+                "[INFO] repeat 0\n"
+                "[INFO] repeat 1\n"
+                "[INFO] repeat 2\n"));
+
+            i64 formatCopies = 0;
+            for (i64 i = 0; i + 9 <= contents.length; i++) {
+                if (memcmp(contents.pData + i, "repeat %i", 9) == 0)
+                    formatCopies++;
+            }
+            VERIFY(formatCopies == 1);
+
+            String stamped = Log::DecodeBinaryLog(contents, g_pArenaFrame, true);
+            VERIFY(stamped.length > decoded.length && stamped.pData[0] == '[');
+        }
+        VERIFY(Log::DecodeBinaryLog(String("not a log"), g_pArenaFrame).length == 0);
+    }
+    EndTest(errorCount);
+}
+
+LOG_DEFINE_CATEGORY(Render, Log::EInfo);
+LOG_DEFINE_CATEGORY(Audio, Log::EWarn);
+
+static i64 g_categoryLogCount;
+
+void CategoryLogHandler(Log::LogLevel level, String message) {
+    BinaryLogHandler(level, message);
+    g_categoryLogCount++;
+}
+
+int CountedArgument(int* pEvaluations) {
+    (*pEvaluations)++;
+    return 5;
+}
+
+void CategoryLogTest() {
+    StartTest("Log Category Test");
+    int errorCount = 0;
+    {
+        Log::LogConfig cfg;
+        cfg.winOutput = false;
+        cfg.consoleOutput = false;
+        cfg.fileOutput = false;
+        cfg.customHandler1 = CategoryLogHandler;
+        Log::SetConfig(cfg);
+        g_categoryLogCount = 0;
+
+        // below the category's level, skipped without even evaluating the arguments
+        int evaluations = 0;
+        LogDebug(Render, "skipped %i", CountedArgument(&evaluations));
+        LogInfo(Audio, "skipped %i", CountedArgument(&evaluations));
+        VERIFY(evaluations == 0);
+        VERIFY(g_categoryLogCount == 0);
+
+        LogInfo(Render, "drawn %i", CountedArgument(&evaluations));
+        VERIFY(evaluations == 1);
+        VERIFY(strcmp(g_binaryLogLast, "[INFO] [Render] drawn 5\n") == 0);
+        LogWarn(Audio, "underrun");
+        VERIFY(strcmp(g_binaryLogLast, "[WARNING] [Audio] underrun\n") == 0);
+
+        // levels change at runtime
+        LOG_CATEGORY(Render).level = Log::EDebug;
+        LogDebug(Render, "now visible");
+        VERIFY(strcmp(g_binaryLogLast, "[DEBUG] [Render] now visible\n") == 0);
+        VERIFY(g_categoryLogCount == 3);
+
+        // the global level still caps everything, categorised or not
+        Log::SetLogLevel(Log::EWarn);
+        LogDebug(Render, "hidden");
+        Log::Info("hidden");
+        VERIFY(g_categoryLogCount == 3);
+        Log::SetLogLevel(Log::EDebug);
+
+        // categories survive the trip through the binary log
+        cfg.binaryOutput = true;
+        Log::SetConfig(cfg);
+        LogInfo(Render, "binary %s", "frame");
+        Log::Flush();
+        VERIFY(strcmp(g_binaryLogLast, "[INFO] [Render] binary frame\n") == 0);
+        VERIFY(g_categoryLogCount == 4);
+
+        LOG_CATEGORY(Render).level = Log::EInfo;
+        Log::SetConfig(Log::LogConfig());
+    }
+    EndTest(errorCount);
+}
+
 void StackTest() {
     StartTest("Stack");
     int errorCount = 0;
@@ -601,9 +1946,19 @@ int main() {
     // LogTest();
     StackTest();
     ArenaTest();
+    ConcurrentArenaTest();
+    PoolTest();
+    RawAllocTest();
+    MemoryTrackerTest();
+    DebugTest();
+    AsyncLogTest();
+    BinaryLogTest();
+    CategoryLogTest();
     ResizableArrayTest();
     StringTest();
     HashMapTest();
+    FlatHashMapTest();
+    HashQualityTest();
     SortTest();
     JsonTest();
     // __debugbreak();
@@ -0,0 +1,79 @@
+#ifdef _WIN32
+#pragma warning (disable : 5105)
+#include "Windows.h"
+#include "dbghelp.h"
+#undef min
+#undef max
+#pragma comment(lib, "gdi32")
+#pragma comment(lib, "kernel32")
+#pragma comment(lib, "psapi")
+#pragma comment(lib, "dbghelp")
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <stdint.h>
+
+#include "common_lib.h"
+#include "common_lib.cpp"
+
+// ---------------------
+// Renders a binary log (LogConfig::binaryOutput) as text
+// usage: log_decoder application.binlog [output.log] [--no-timestamps]
+// ---------------------
+
+int main(int argc, char** argv) {
+	g_pArenaFrame = ArenaCreate();
+	g_pArenaPermenant = ArenaCreate();
+
+    const char* inputPath = nullptr;
+    const char* outputPath = nullptr;
+    bool timestamps = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-timestamps") == 0)
+            timestamps = false;
+        else if (inputPath == nullptr)
+            inputPath = argv[i];
+        else
+            outputPath = argv[i];
+    }
+    if (inputPath == nullptr) {
+        printf("usage: log_decoder application.binlog [output.log] [--no-timestamps]\n");
+        return 1;
+    }
+
+    FILE* pInput = fopen(inputPath, "rb");
+    if (pInput == nullptr) {
+        printf("Couldn't open %s\n", inputPath);
+        return 1;
+    }
+    fseek(pInput, 0, SEEK_END);
+    i64 size = ftell(pInput);
+    fseek(pInput, 0, SEEK_SET);
+    String contents = AllocString(size, g_pArenaPermenant);
+    contents.length = fread(contents.pData, 1, size, pInput);
+    fclose(pInput);
+
+    String text = Log::DecodeBinaryLog(contents, g_pArenaPermenant, timestamps);
+    if (text.length == 0 && contents.length > 0) {
+        printf("%s is not a binary log\n", inputPath);
+        return 1;
+    }
+
+    FILE* pOutput = stdout;
+    if (outputPath) {
+        pOutput = fopen(outputPath, "w");
+        if (pOutput == nullptr) {
+            printf("Couldn't open %s\n", outputPath);
+            return 1;
+        }
+    }
+    fwrite(text.pData, 1, text.length, pOutput);
+    if (pOutput != stdout)
+        fclose(pOutput);
+    return 0;
+}